@@ -3,6 +3,11 @@
 #include <mutex>
 #include <future>
 #include <semaphore>
+#include <map>
+#include <optional>
+#include <algorithm>
+#include <fstream>
+#include <cstring>
 #ifdef _WIN32
 #include <windows.h>
 #include <io.h>
@@ -12,33 +17,88 @@
 #include "src/flat_log.h"
 #include "src/simd_support.h"
 #include "src/argument_parser.h"
+#include "src/log_merger.h"
+#include "src/stream_flat_log.h"
+#include "src/log_discovery.h"
+#include "src/memory_budget.h"
+#include "src/throttle.h"
+#include "src/shard_plan.h"
+#include "src/log_hash.h"
+#include "src/log_verifier.h"
+#include "src/event_index.h"
+#include "src/event_counter.h"
+#include "src/event_reader.h"
+#include "src/trace_query.h"
+#include "src/trace_collector.h"
+#include "src/file_summary.h"
+#include "src/retention_rule.h"
+#include "src/log_compactor.h"
+#include "src/log_splitter.h"
+#include "src/device_scheduler.h"
+#include "src/result_cache.h"
+#include "src/log_view.h"
+#include "src/store_builder.h"
+#include "src/event_store.h"
 
 using namespace std;
 
 using FlatLog = soldy::FlatLog;
 using SimdSupport = soldy::SimdSupport;
 using ArgumentParser = soldy::ArgumentParser;
+using LogMerger = soldy::LogMerger;
+using StreamFlatLog = soldy::StreamFlatLog;
+using Codec = soldy::Codec;
+using LogDiscovery = soldy::LogDiscovery;
+using MemoryBudget = soldy::MemoryBudget;
+using Throttle = soldy::Throttle;
+using ShardPlan = soldy::ShardPlan;
+using LogHash = soldy::LogHash;
+using LogVerifier = soldy::LogVerifier;
+using EventIndex = soldy::EventIndex;
+using EventCounter = soldy::EventCounter;
+using EventReader = soldy::EventReader;
+using TraceQuery = soldy::TraceQuery;
+using TraceCollector = soldy::TraceCollector;
+using FileSummary = soldy::FileSummary;
+using RetentionRule = soldy::RetentionRule;
+using LogCompactor = soldy::LogCompactor;
+using LogSplitter = soldy::LogSplitter;
+using ResultCache = soldy::ResultCache;
+using LogView = soldy::LogView;
+using StoreBuilder = soldy::StoreBuilder;
+using EventStore = soldy::EventStore;
+template <typename T>
+using DeviceScheduler = soldy::DeviceScheduler<T>;
 namespace fs = std::filesystem;
 
 mutex coutMutex;
 
 static wstring error_str(error_code& ec) {
-    char* old_locale = std::setlocale(LC_ALL, nullptr);
+    //Строка setlocale перезаписывается следующим вызовом, сохраняем копию
+    const std::string old_locale = std::setlocale(LC_ALL, nullptr);
     std::setlocale(LC_ALL, "en_US.UTF-8");
 
     std::string category = ec.category().name();
+    const std::string message = ec.message();
 
     std::wstring error_str;
     error_str
-        .append(L"Error: ").append(std::wstring(ec.message().begin(), ec.message().end()))
+        .append(L"Error: ").append(std::wstring(message.begin(), message.end()))
         .append(L" (code: ").append(std::to_wstring(ec.value()))
         .append(L", category: ").append(std::wstring(category.begin(), category.end())).append(L")");
 
-    std::setlocale(LC_ALL, old_locale);
+    std::setlocale(LC_ALL, old_locale.c_str());
 
     return error_str;
 }
 
+//Строка параметров запуска перед выводом режима (кроме show и query: их вывод - данные)
+void printMode(const ArgumentParser& arguments, SimdSupport::SimdLevel simd_level) {
+    wcout << L"SIMD: " << SimdSupport::SimdLevelToString(simd_level)
+        << L"; Mode=" << arguments.GetMode() << L";"
+        << L"Thread=" << arguments.GetCountThread() << endl;
+}
+
 SimdSupport::SimdLevel getSimdLevel(const ArgumentParser& arguments) {
     
     wstring simd_level_wstr = arguments.GetSimd();
@@ -55,47 +115,297 @@ SimdSupport::SimdLevel getSimdLevel(const ArgumentParser& arguments) {
     return simd_level;
 }
 
-vector<fs::path> getLogFiles(const wstring& path) {
-    std::vector<fs::path> logFiles;
-
-    try {
-        fs::path filePath(path);
+LogDiscovery::Filter getDiscoveryFilter(const ArgumentParser& arguments) {
+    LogDiscovery::Filter filter;
+    filter.by = arguments.GetFilterBy() == L"mtime" ? LogDiscovery::Filter::By::Mtime : LogDiscovery::Filter::By::Name;
+    filter.since = arguments.GetSince();
+    filter.until = arguments.GetUntil();
+    filter.include = arguments.GetInclude();
+    filter.exclude = arguments.GetExclude();
+    filter.include_active = arguments.IsIncludeActive();
+    return filter;
+}
 
-        if (!fs::exists(filePath)) {
+bool startDiscovery(LogDiscovery& discovery, const wstring& path) {
+    error_code ec;
+    if (!discovery.Start(ec)) {
+        if (ec == errc::no_such_file_or_directory) {
             std::wcout << "Error: the directory or file '" << path << "' does not exist." << std::endl;
-            return logFiles;
         }
+        else {
+            std::wcout << "Error: could not retrieve log files due to " << error_str(ec) << std::endl;
+        }
+        return false;
+    }
+    return true;
+}
+
+//Файлы (или части файлов, --shard) обрабатываются в --thread потоках: поток берет элемент с наименее загруженного
+//устройства, не больше --per-device одновременно с одного. feed заполняет очереди устройств параллельно с обработкой.
+//make_handler вызывается в каждом потоке и возвращает обработчик элемента с состоянием потока (буферы, компактор).
+//Исключение при обработке элемента считается ошибкой
+template <typename Item, typename Feed, typename MakeHandler>
+void processFiles(const ArgumentParser& arguments, atomic<size_t>& errors, Feed feed, MakeHandler make_handler) {
+    DeviceScheduler<Item> scheduler(arguments.GetPerDevice());
+    auto feeding = std::async(std::launch::async, [&scheduler, &feed]() {
+        feed(scheduler);
+        scheduler.Close();
+    });
 
-        if (fs::is_directory(filePath)) {
-            for (const auto& entry : fs::recursive_directory_iterator(filePath)) {
-                if (fs::is_regular_file(entry) &&
-                    entry.path().extension() == ".log") {
-                    logFiles.push_back(entry.path());
+    std::vector<std::future<void>> futures;
+    for (int i = 0; i < arguments.GetCountThread(); ++i) {
+        futures.push_back(std::async(std::launch::async, [&scheduler, &errors, &make_handler]() {
+            auto handle = make_handler();
+            Item item;
+            uint64_t device = 0;
+            while (scheduler.Acquire(item, device)) {
+                try {
+                    handle(item);
+                }
+                catch (...) {
+                    ++errors;
                 }
+                scheduler.Release(device);
             }
+        }));
+    }
+
+    for (auto& future : futures) {
+        future.get();
+    }
+    feeding.get();
+}
+
+//Файлы из обхода каталогов обрабатываются по мере обнаружения
+template <typename MakeHandler>
+void processFiles(LogDiscovery& discovery, const ArgumentParser& arguments, atomic<size_t>& errors, MakeHandler make_handler) {
+    processFiles<fs::path>(arguments, errors, [&discovery](DeviceScheduler<fs::path>& scheduler) {
+        fs::path file;
+        while (discovery.Next(file)) {
+            scheduler.Push(soldy::DeviceOf(file), file);
         }
-        else if (fs::is_regular_file(filePath) && filePath.extension() == ".log") {
-            logFiles.push_back(filePath);
+    }, make_handler);
+}
+
+vector<fs::path> getLogFiles(const ArgumentParser& arguments) {
+    LogDiscovery discovery(arguments.GetPath(), getDiscoveryFilter(arguments));
+    if (!startDiscovery(discovery, arguments.GetPath())) {
+        return {};
+    }
+    return discovery.Collect();
+}
+
+//Часть логов этого процесса (--shard=i/N), без параметра - все логи
+optional<ShardPlan> getShardPlan(const ArgumentParser& arguments) {
+    size_t index = 0, count = 0;
+    if (!ShardPlan::Parse(arguments.GetShard(), index, count)) {
+        return nullopt;
+    }
+    const size_t split_mb = arguments.GetShardSplit();
+    return ShardPlan(index, count, split_mb ? split_mb * 1024 * 1024 : ShardPlan::DEFAULT_SPLIT_SIZE);
+}
+
+struct ConvertOptions {
+    FlatLog::Mode mode = FlatLog::Mode::Flat;
+    size_t chank_size = 0;
+    //Число потоков для размера региона по умолчанию, он подбирается по размеру файла (0 - размер задан --chank)
+    size_t thread_count = 0;
+    SimdSupport::SimdLevel simd_level = SimdSupport::SimdLevel::None;
+    wstring compress;
+    MemoryBudget* memory_budget = nullptr;
+    Throttle* throttle = nullptr;
+    bool drop_cache = true;
+    bool record_hash = false;
+    bool dry_run = false;
+    bool build_index = false;
+    bool build_summary = false;
+    //Общая статистика событий всех файлов (nullptr - не собирается)
+    EventCounter* stats = nullptr;
+    //Кэш результатов dry-run по файлам (nullptr - без кэша)
+    const ResultCache* cache = nullptr;
+};
+
+mutex statsMutex;
+
+//Итог по измененным символам всех файлов. Части одного файла (--shard) считаются одним файлом:
+//он без изменений, только если без изменений все его части
+class ChangeTotals {
+private:
+    mutex mutex_;
+    map<fs::path, bool> split_files_;
+    size_t unchanged_files_ = 0;
+public:
+    atomic<size_t> lf{ 0 };
+    atomic<size_t> cr{ 0 };
+
+    void Add(const ShardPlan::FileRange& range, const FlatLog::Changes& changes) {
+        lf += changes.lf;
+        cr += changes.cr;
+        lock_guard<mutex> lock(mutex_);
+        if (range.end) {
+            split_files_[range.path] |= changes.Total() != 0;
         }
+        else if (!changes.Total()) {
+            ++unchanged_files_;
+        }
+    }
+    size_t UnchangedFiles() {
+        lock_guard<mutex> lock(mutex_);
+        return unchanged_files_ + count_if(split_files_.begin(), split_files_.end(), [](const auto& file) { return !file.second; });
     }
-    catch (const std::exception& ex) {
-        std::wcout << "Error: could not retrieve log files due to " << ex.what() << std::endl;
+};
+
+wstring changesStr(const FlatLog::Changes& changes, bool dry_run) {
+    if (!changes.Total()) {
+        return L", no changes";
     }
+    return (dry_run ? L", would change LF: " : L", changed LF: ") + to_wstring(changes.lf) + L", CR: " + to_wstring(changes.cr);
+}
 
-    return logFiles;
+//События по убыванию количества
+void printStats(const EventCounter& stats) {
+    vector<pair<string, EventCounter::Item>> items(stats.Items().begin(), stats.Items().end());
+    sort(items.begin(), items.end(), [](const auto& a, const auto& b) {
+        return a.second.count != b.second.count ? a.second.count > b.second.count : a.first < b.first;
+    });
+    wcout << L"Events: " << stats.Events() << L", without header: " << stats.Invalid() << endl;
+    for (const auto& [name, item] : items) {
+        wcout << L"  " << wstring(name.begin(), name.end()) << L": " << item.count << L", duration: " << item.duration << endl;
+    }
 }
 
-size_t convertFile(const fs::path& file, FlatLog::Mode mode, size_t chank_size, SimdSupport::SimdLevel simd_level) {
+//Хеш исходного файла для режима verify, ошибка записи не отменяет преобразование
+void writeHash(const fs::path& file, const LogHash& hash) {
+    error_code ec;
+    if (!LogHash::WriteSidecar(file, hash.Digest(), hash.Size(), ec)) {
+        lock_guard<mutex> lock(coutMutex);
+        wcout << L"Warning: hash of file '" << file.wstring() << L"' not saved (" << error_str(ec) << L")" << endl;
+    }
+}
+
+//Сжатые журналы (или запрос на сжатие результата) обрабатываются потоково за один проход
+bool convertStream(const fs::path& file, Codec out_codec, const ConvertOptions& options, size_t& size, FlatLog::Changes& changes) {
     auto start = chrono::high_resolution_clock::now();
 
-    FlatLog flat_log(file.string());
+    MemoryBudget::Lease lease(options.memory_budget, StreamFlatLog::MemoryFootprint());
+    StreamFlatLog stream_flat_log(file);
+    stream_flat_log.SetSimdLevel(options.simd_level);
+    stream_flat_log.SetThrottle(options.throttle);
+    stream_flat_log.SetDryRun(options.dry_run);
+    const bool record_hash = options.record_hash && options.mode == FlatLog::Mode::Flat && !options.dry_run;
+    LogHash hash(options.simd_level);
+    if (record_hash) {
+        stream_flat_log.SetHash(&hash);
+    }
     error_code ec;
+    if (!stream_flat_log.Process(options.mode, out_codec, ec)) {
+        lock_guard<mutex> lock(coutMutex);
+        wcout << L"Error: file '" << file.wstring() << L"' not processed (" << error_str(ec) << L")" << endl;
+        return false;
+    }
+    //Сохраненный хеш переезжает вместе с файлом
+    if (!options.dry_run && stream_flat_log.OutputPath() != file && fs::exists(LogHash::SidecarPath(file), ec)) {
+        fs::rename(LogHash::SidecarPath(file), LogHash::SidecarPath(stream_flat_log.OutputPath()), ec);
+    }
+    if (record_hash) {
+        writeHash(stream_flat_log.OutputPath(), hash);
+    }
+
+    auto end = chrono::high_resolution_clock::now();
+    auto duration = chrono::duration_cast<chrono::microseconds>(end - start);
+
+    {
+        lock_guard<mutex> lock(coutMutex);
+        wcout << L"file '" << file.wstring() << L"': " << stream_flat_log.Size() << L" bytes"
+            << changesStr(stream_flat_log.GetChanges(), options.dry_run) << L" in " << duration.count() << L" microseconds";
+        if (!options.dry_run && stream_flat_log.OutputPath() != file) {
+            wcout << L" -> '" << stream_flat_log.OutputPath().wstring() << L"'";
+        }
+        wcout << endl;
+    }
+
+    size = stream_flat_log.Size();
+    changes = stream_flat_log.GetChanges();
+    return true;
+}
+
+//Результат dry-run: изменения и статистика событий (считается всегда, чтобы запись подошла и запросу с --stats)
+string dryRunSignature(const ConvertOptions& options) {
+    return options.mode == FlatLog::Mode::Flat ? "dry-run:flat" : "dry-run:unflat";
+}
+
+bool loadDryRun(const ResultCache::FileKey& key, const ConvertOptions& options, FlatLog::Changes& changes, EventCounter& counter) {
+    string payload;
+    if (!options.cache->Load(key, dryRunSignature(options), payload) || payload.size() < 2 * sizeof(uint64_t)) {
+        return false;
+    }
+    uint64_t lf = 0, cr = 0;
+    memcpy(&lf, payload.data(), sizeof(lf));
+    memcpy(&cr, payload.data() + sizeof(lf), sizeof(cr));
+    changes.lf = lf;
+    changes.cr = cr;
+    return counter.Deserialize(string_view(payload).substr(2 * sizeof(uint64_t)));
+}
+
+void storeDryRun(const fs::path& file, const ResultCache::FileKey& key, const ConvertOptions& options,
+    const FlatLog::Changes& changes, const EventCounter& counter) {
+    string payload;
+    const uint64_t lf = changes.lf, cr = changes.cr;
+    payload.append(reinterpret_cast<const char*>(&lf), sizeof(lf));
+    payload.append(reinterpret_cast<const char*>(&cr), sizeof(cr));
+    counter.Serialize(payload);
+    error_code ec;
+    if (!options.cache->Store(key, dryRunSignature(options), payload, ec)) {
+        lock_guard<mutex> lock(coutMutex);
+        wcout << L"Warning: result of file '" << file.wstring() << L"' not cached (" << error_str(ec) << L")" << endl;
+    }
+}
+
+//Ошибка - false, пустой файл пропускается без ошибки с нулевым size
+bool convertFile(const ShardPlan::FileRange& range, const ConvertOptions& options, size_t& size, FlatLog::Changes& changes) {
+    const fs::path& file = range.path;
+    Codec in_codec = soldy::CodecFromPath(file);
+    if (in_codec != Codec::None || !options.compress.empty()) {
+        Codec out_codec = options.compress.empty() ? in_codec
+            : options.compress == L"gzip" ? Codec::Gzip : options.compress == L"zstd" ? Codec::Zstd : Codec::None;
+        return convertStream(file, out_codec, options, size, changes);
+    }
+
+    auto start = chrono::high_resolution_clock::now();
+
+    //Файл не менялся с прошлого dry-run (--cache): результат берется из кэша без чтения файла
+    error_code ec;
+    ResultCache::FileKey cache_key;
+    const bool use_cache = options.cache && options.dry_run && !range.end && !options.build_index && !options.build_summary
+        && ResultCache::KeyOf(file, cache_key, ec);
+    EventCounter counter;
+    if (use_cache) {
+        if (loadDryRun(cache_key, options, changes, counter)) {
+            if (options.stats) {
+                lock_guard<mutex> lock(statsMutex);
+                options.stats->Merge(counter);
+            }
+            auto end = chrono::high_resolution_clock::now();
+            auto duration = chrono::duration_cast<chrono::microseconds>(end - start);
+
+            lock_guard<mutex> lock(coutMutex);
+            wcout << L"file '" << file.wstring() << L"': " << cache_key.size << L" bytes" << changesStr(changes, options.dry_run)
+                << L" (cached) in " << duration.count() << L" microseconds" << endl;
+            size = cache_key.size;
+            return true;
+        }
+        counter = EventCounter();
+    }
+    ec.clear();
+
+    FlatLog flat_log(file.string());
+    flat_log.SetDryRun(options.dry_run);
     if (!flat_log.Open(ec)) {
         {
             lock_guard<mutex> lock(coutMutex);
             wcout << L"Error: file '" << file.wstring() << L"' not open (" << error_str(ec) << L")" << endl;
         }
-        return 0;
+        return false;
     }
 
     if (flat_log.FileSize() <= 3) {
@@ -103,15 +413,52 @@ size_t convertFile(const fs::path& file, FlatLog::Mode mode, size_t chank_size,
             lock_guard<mutex> lock(coutMutex);
             wcout << L"File '" << file.wstring() << L"'is empty, skipping" << endl;
         }
-        return 0;
+        return true;
     }
 
-    flat_log.SetSimdLevel(simd_level);
+    flat_log.SetSimdLevel(options.simd_level);
+    flat_log.SetMemoryBudget(options.memory_budget);
+    flat_log.SetDropCache(options.drop_cache);
+    flat_log.SetThrottle(options.throttle);
+    const bool record_hash = options.record_hash && options.mode == FlatLog::Mode::Flat && !range.end && !options.dry_run;
+    LogHash hash(options.simd_level);
+    if (record_hash) {
+        flat_log.SetHash(&hash);
+    }
+    //Индекс, сводка и статистика строятся за тот же проход по файлу. Индекс и сводка - только для файла целиком
+    const bool build_index = options.build_index && !range.end;
+    const bool build_summary = options.build_summary && !range.end;
+    EventIndex index;
+    FileSummary summary(options.simd_level);
+    if (build_index) {
+        flat_log.AddConsumer(&index);
+    }
+    if (build_summary) {
+        flat_log.AddConsumer(&summary);
+    }
+    if (options.stats || use_cache) {
+        flat_log.AddConsumer(&counter);
+    }
        
-    if (!flat_log.ProcessData(mode, chank_size, ec)) {
+    const size_t range_end = range.end ? range.end : flat_log.FileSize();
+    const size_t chank_size = options.thread_count && options.memory_budget
+        ? MemoryBudget::AutoRegionSize(options.memory_budget->Capacity(), options.thread_count, range_end - range.begin)
+        : options.chank_size;
+    if (!flat_log.ProcessRange(options.mode, range.begin, range_end, chank_size, ec)) {
         lock_guard<mutex> lock(coutMutex);
         wcout << error_str(ec) << endl;
-        return 0;
+        return false;
+    }
+
+    if (record_hash) {
+        writeHash(file, hash);
+    }
+    if (use_cache) {
+        storeDryRun(file, cache_key, options, flat_log.GetChanges(), counter);
+    }
+    if (options.stats) {
+        lock_guard<mutex> lock(statsMutex);
+        options.stats->Merge(counter);
     }
 
     auto end = chrono::high_resolution_clock::now();
@@ -119,10 +466,937 @@ size_t convertFile(const fs::path& file, FlatLog::Mode mode, size_t chank_size,
     
     {
         lock_guard<mutex> lock(coutMutex);
-        wcout << L"file '" << file.wstring() << L"': " << flat_log.FileSize() << L" bytes in " << duration.count() << L" microseconds" << endl;
+        wcout << L"file '" << file.wstring() << L"'";
+        if (range.end) {
+            wcout << L" [" << range.begin << L", " << range.end << L")";
+        }
+        wcout << L": " << range_end - range.begin << L" bytes" << changesStr(flat_log.GetChanges(), options.dry_run);
+        if (build_index) {
+            wcout << L", indexed events: " << index.Count();
+        }
+        wcout << L" in " << duration.count() << L" microseconds" << endl;
+    }
+
+    size = range_end - range.begin;
+    changes = flat_log.GetChanges();
+    return true;
+}
+
+size_t mergeHour(const wstring& hour, const vector<fs::path>& files, const fs::path& out_dir, SimdSupport::SimdLevel simd_level) {
+    auto start = chrono::high_resolution_clock::now();
+
+    fs::path output = out_dir / (hour + L".log");
+    LogMerger merger(simd_level);
+    error_code ec;
+    if (!merger.Merge(files, output, ec)) {
+        lock_guard<mutex> lock(coutMutex);
+        wcout << L"Error: hour '" << hour << L"' not merged (" << error_str(ec) << L")" << endl;
+        return 0;
+    }
+
+    auto end = chrono::high_resolution_clock::now();
+    auto duration = chrono::duration_cast<chrono::microseconds>(end - start);
+
+    {
+        lock_guard<mutex> lock(coutMutex);
+        wcout << L"hour '" << hour << L"': " << files.size() << L" files, " << merger.EventCount() << L" events, "
+            << merger.InputSize() << L" bytes in " << duration.count() << L" microseconds -> '" << output.wstring() << L"'" << endl;
     }
 
-    return flat_log.FileSize();
+    return merger.InputSize();
+}
+
+int mergeLogs(const ArgumentParser& arguments, SimdSupport::SimdLevel simd_level) {
+    wstring out = arguments.GetOut();
+    if (out.empty()) {
+        wcout << "Error: the '-O [--out]' parameter is empty. Specify the output directory for merge mode." << endl;
+        return 0;
+    }
+
+    error_code ec;
+    fs::path out_dir(out);
+    fs::create_directories(out_dir, ec);
+    if (ec) {
+        wcout << L"Error: directory '" << out << L"' not created (" << error_str(ec) << L")" << endl;
+        return 0;
+    }
+    const fs::path out_canonical = fs::weakly_canonical(out_dir, ec);
+
+    //Группируем файлы по часу, результаты предыдущих слияний в выходном каталоге пропускаем
+    const wstring hour_filter = arguments.GetHour();
+    map<wstring, vector<fs::path>> hours;
+    for (const auto& file : getLogFiles(arguments)) {
+        wstring hour = LogDiscovery::HourOf(file);
+        if (hour.empty() || soldy::CodecFromPath(file) != Codec::None
+            || fs::weakly_canonical(file.parent_path(), ec) == out_canonical) {
+            continue;
+        }
+        if (!hour_filter.empty() && hour != hour_filter) {
+            continue;
+        }
+        hours[hour].push_back(file);
+    }
+
+    //При --shard процесс сливает только свои часы
+    if (auto shard_plan = getShardPlan(arguments)) {
+        vector<ShardPlan::Item> items;
+        for (const auto& [hour, files] : hours) {
+            size_t size = 0;
+            for (const auto& file : files) {
+                error_code size_ec;
+                const auto file_size = fs::file_size(file, size_ec);
+                size += size_ec ? 0 : static_cast<size_t>(file_size);
+            }
+            items.push_back({ hour, size });
+        }
+        map<wstring, vector<fs::path>> selected;
+        for (size_t i : shard_plan->Select(items)) {
+            selected[items[i].key] = std::move(hours[items[i].key]);
+        }
+        hours = std::move(selected);
+    }
+
+    atomic<size_t> all_size{ 0 };
+    auto start = chrono::high_resolution_clock::now();
+
+    counting_semaphore<> semaphore(arguments.GetCountThread());
+    std::vector<std::future<size_t>> futures;
+    for (auto& [hour, files] : hours) {
+        sort(files.begin(), files.end());
+        semaphore.acquire();
+
+        futures.push_back(std::async(std::launch::async,
+            [&semaphore, &all_size, &hour, &files, &out_dir, simd_level]() -> size_t {
+                try {
+                    size_t size = mergeHour(hour, files, out_dir, simd_level);
+                    all_size += size;
+                    semaphore.release();
+                    return size;
+                }
+                catch (...) {
+                    semaphore.release();
+                    return 0;
+                }
+            }));
+    }
+
+    for (auto& future : futures) {
+        future.get();
+    }
+
+    auto end = chrono::high_resolution_clock::now();
+    auto duration = chrono::duration_cast<chrono::microseconds>(end - start);
+
+    wcout << L"All in hours: " << hours.size() << L", " << all_size << L" bytes in " << duration.count() << L" microseconds" << endl;
+    return 0;
+}
+
+enum class VerifyStatus {
+    Ok,
+    Mismatch,
+    NoHash,
+    Error
+};
+
+VerifyStatus verifyFile(const fs::path& file, SimdSupport::SimdLevel simd_level, size_t& size) {
+    auto start = chrono::high_resolution_clock::now();
+
+    LogVerifier verifier(simd_level);
+    error_code ec;
+    if (!verifier.Verify(file, ec)) {
+        lock_guard<mutex> lock(coutMutex);
+        wcout << L"Error: file '" << file.wstring() << L"' not verified (" << error_str(ec) << L")" << endl;
+        return VerifyStatus::Error;
+    }
+    size = verifier.Size();
+
+    uint64_t expected_digest = 0;
+    uint64_t expected_size = 0;
+    VerifyStatus status = VerifyStatus::NoHash;
+    if (LogHash::ReadSidecar(file, expected_digest, expected_size, ec)) {
+        status = (expected_digest == verifier.Digest() && expected_size == verifier.Size()) ? VerifyStatus::Ok : VerifyStatus::Mismatch;
+    }
+
+    auto end = chrono::high_resolution_clock::now();
+    auto duration = chrono::duration_cast<chrono::microseconds>(end - start);
+
+    lock_guard<mutex> lock(coutMutex);
+    wcout << L"file '" << file.wstring() << L"': ";
+    if (status == VerifyStatus::Ok) {
+        wcout << L"OK " << LogHash::ToHex(verifier.Digest());
+    }
+    else if (status == VerifyStatus::Mismatch) {
+        wcout << L"MISMATCH expected " << LogHash::ToHex(expected_digest) << L" (" << expected_size << L" bytes), actual "
+            << LogHash::ToHex(verifier.Digest()) << L" (" << verifier.Size() << L" bytes)";
+    }
+    else {
+        wcout << L"no saved hash, unflat view " << LogHash::ToHex(verifier.Digest());
+    }
+    if (verifier.RawCr() || verifier.RawLf()) {
+        wcout << L"; raw 0x01: " << verifier.RawCr() << L", raw 0x02: " << verifier.RawLf()
+            << L", first at offset " << verifier.FirstRawOffset();
+    }
+    wcout << L"; " << verifier.Size() << L" bytes in " << duration.count() << L" microseconds" << endl;
+    return status;
+}
+
+int verifyLogs(const ArgumentParser& arguments, SimdSupport::SimdLevel simd_level) {
+    LogDiscovery discovery(arguments.GetPath(), getDiscoveryFilter(arguments));
+    if (!startDiscovery(discovery, arguments.GetPath())) {
+        return 0;
+    }
+
+    atomic<size_t> all_size{ 0 };
+    atomic<size_t> counts[4] = {};
+    auto start = chrono::high_resolution_clock::now();
+
+    processFiles(discovery, arguments, counts[static_cast<size_t>(VerifyStatus::Error)], [&all_size, &counts, simd_level]() {
+        return [&all_size, &counts, simd_level](const fs::path& file) {
+            size_t size = 0;
+            VerifyStatus status = verifyFile(file, simd_level, size);
+            ++counts[static_cast<size_t>(status)];
+            all_size += size;
+        };
+    });
+
+    auto end = chrono::high_resolution_clock::now();
+    auto duration = chrono::duration_cast<chrono::microseconds>(end - start);
+
+    wcout << L"All in files: " << all_size << L" bytes in " << duration.count() << L" microseconds; OK: "
+        << counts[static_cast<size_t>(VerifyStatus::Ok)] << L", mismatch: " << counts[static_cast<size_t>(VerifyStatus::Mismatch)]
+        << L", no hash: " << counts[static_cast<size_t>(VerifyStatus::NoHash)] << L", errors: " << counts[static_cast<size_t>(VerifyStatus::Error)] << endl;
+    //Код возврата для сценариев: удалять резервные копии можно только при 0
+    return (counts[static_cast<size_t>(VerifyStatus::Mismatch)] || counts[static_cast<size_t>(VerifyStatus::Error)]) ? 1 : 0;
+}
+
+//Начало часа файла в микросекундах: час YYMMDDHH из имени файла, 0 - имя не по шаблону
+uint64_t hourTime(const fs::path& file) {
+    const wstring hour = LogDiscovery::HourOf(file);
+    return hour.empty() ? 0 : stoull(hour) * 3600ULL * 1000000ULL;
+}
+
+//Отбор событий трассировки из одного файла. Время события - час из имени файла и метка MM:SS.ffffff
+//Отобранные события файла из кэша (--cache): читаются только они, без просмотра файла
+bool traceCached(const fs::path& file, const ResultCache::FileKey& key, const string& payload, size_t order, const string& label,
+    uint64_t hour_time, TraceCollector& collector, size_t& file_matched, error_code& ec) {
+    ifstream stream(file, ios::binary);
+    if (!stream) {
+        ec = make_error_code(errc::no_such_file_or_directory);
+        return false;
+    }
+    vector<char> event;
+    for (size_t i = 0; i + 2 * sizeof(uint64_t) <= payload.size(); i += 2 * sizeof(uint64_t)) {
+        uint64_t offset = 0, size = 0;
+        memcpy(&offset, payload.data() + i, sizeof(offset));
+        memcpy(&size, payload.data() + i + sizeof(offset), sizeof(size));
+        if (size < soldy::LogEvent::TIMESTAMP_SIZE || offset + size > key.size) {
+            ec = make_error_code(errc::invalid_argument);
+            return false;
+        }
+        event.resize(size);
+        stream.seekg(static_cast<streamoff>(offset));
+        if (!stream.read(event.data(), static_cast<streamsize>(size))) {
+            ec = make_error_code(errc::io_error);
+            return false;
+        }
+        const TraceCollector::Key event_key{ hour_time + soldy::LogEvent::Timestamp(event.data()), order, offset };
+        if (!collector.Add(event_key, label, event.data(), size, ec)) {
+            return false;
+        }
+        ++file_matched;
+    }
+    return true;
+}
+
+//Ошибка чтения файла учитывается в errors. Отобранные до ошибки события остаются в трассировке и учитываются в matched
+size_t traceFile(const fs::path& file, size_t order, const string& label, const TraceQuery& query, const ResultCache* cache,
+    const string& signature, TraceCollector& collector, SimdSupport::SimdLevel simd_level, size_t& matched, size_t& skipped, size_t& errors) {
+    auto start = chrono::high_resolution_clock::now();
+
+    const uint64_t hour_time = hourTime(file);
+    error_code ec;
+    //Смещения и размеры отобранных событий закрытого файла берутся из кэша
+    ResultCache::FileKey cache_key;
+    const bool use_cache = cache && ResultCache::KeyOf(file, cache_key, ec);
+    string payload;
+    if (use_cache && cache->Load(cache_key, signature, payload)) {
+        size_t file_matched = 0;
+        const bool is_traced = traceCached(file, cache_key, payload, order, label, hour_time, collector, file_matched, ec);
+        matched += file_matched;
+        if (!is_traced) {
+            ++errors;
+            lock_guard<mutex> lock(coutMutex);
+            wcout << L"Error: file '" << file.wstring() << L"' traced partially, matched events: " << file_matched
+                << L" (" << error_str(ec) << L")" << endl;
+            return 0;
+        }
+
+        auto end = chrono::high_resolution_clock::now();
+        auto duration = chrono::duration_cast<chrono::microseconds>(end - start);
+
+        lock_guard<mutex> lock(coutMutex);
+        wcout << L"file '" << file.wstring() << L"': " << cache_key.size << L" bytes, matched events: " << file_matched
+            << L" (cached) in " << duration.count() << L" microseconds" << endl;
+        return cache_key.size;
+    }
+    payload.clear();
+    ec.clear();
+
+    //Файл, сводка которого исключает искомые значения, не читается. Нет сводки или она устарела - читаем
+    FileSummary summary(simd_level);
+    if (summary.Load(file, ec) && !query.MayMatch(summary)) {
+        ++skipped;
+        return 0;
+    }
+    ec.clear();
+
+    EventReader reader(simd_level);
+    if (!reader.Open(file, ec)) {
+        ++errors;
+        lock_guard<mutex> lock(coutMutex);
+        wcout << L"Error: file '" << file.wstring() << L"' not open (" << error_str(ec) << L")" << endl;
+        return 0;
+    }
+    size_t file_matched = 0;
+    while (reader.Next(ec)) {
+        if (!query.Match(reader.Data(), reader.Size())) {
+            continue;
+        }
+        const TraceCollector::Key key{ hour_time + reader.Timestamp(), order, reader.Offset() };
+        if (!collector.Add(key, label, reader.Data(), reader.Size(), ec)) {
+            break;
+        }
+        if (use_cache) {
+            const uint64_t entry[2] = { reader.Offset(), reader.Size() };
+            payload.append(reinterpret_cast<const char*>(entry), sizeof(entry));
+        }
+        ++file_matched;
+    }
+    matched += file_matched;
+    if (ec) {
+        ++errors;
+        lock_guard<mutex> lock(coutMutex);
+        wcout << L"Error: file '" << file.wstring() << L"' traced partially, matched events: " << file_matched
+            << L" (" << error_str(ec) << L")" << endl;
+        return 0;
+    }
+    if (use_cache && !cache->Store(cache_key, signature, payload, ec)) {
+        lock_guard<mutex> lock(coutMutex);
+        wcout << L"Warning: result of file '" << file.wstring() << L"' not cached (" << error_str(ec) << L")" << endl;
+    }
+
+    auto end = chrono::high_resolution_clock::now();
+    auto duration = chrono::duration_cast<chrono::microseconds>(end - start);
+
+    lock_guard<mutex> lock(coutMutex);
+    wcout << L"file '" << file.wstring() << L"': " << reader.FileSize() << L" bytes, matched events: " << file_matched
+        << L" in " << duration.count() << L" microseconds" << endl;
+    return reader.FileSize();
+}
+
+//События сеансов и соединений из всех файлов в одном упорядоченном по времени файле.
+//Память ограничена буферами потоков (--mem-budget), отобранное сверх них сбрасывается во временные серии
+int traceLogs(const ArgumentParser& arguments, SimdSupport::SimdLevel simd_level) {
+    wstring out = arguments.GetOut();
+    if (out.empty()) {
+        wcout << "Error: the '-O [--out]' parameter is empty. Specify the output file for trace mode." << endl;
+        return 0;
+    }
+    TraceQuery query(simd_level);
+    for (const auto& value : arguments.GetSession()) {
+        query.Add("SessionID", string(value.begin(), value.end()));
+    }
+    for (const auto& value : arguments.GetConnect()) {
+        query.Add("t:connectID", string(value.begin(), value.end()));
+    }
+    if (query.Empty()) {
+        wcout << "Error: specify '--session' or '--connect' for trace mode." << endl;
+        return 0;
+    }
+    const string signature = "trace:" + query.Signature();
+    optional<ResultCache> cache;
+    if (!arguments.GetCache().empty()) {
+        cache.emplace(arguments.GetCache());
+    }
+
+    error_code ec;
+    const fs::path output(out);
+    fs::path run_dir = output;
+    run_dir += L".runs";
+    fs::create_directories(run_dir, ec);
+    if (ec) {
+        wcout << L"Error: directory '" << run_dir.wstring() << L"' not created (" << error_str(ec) << L")" << endl;
+        return 0;
+    }
+
+    //Номер файла в отсортированном списке упорядочивает события с одинаковым временем
+    const fs::path root(arguments.GetPath());
+    const fs::path output_canonical = fs::weakly_canonical(output, ec);
+    vector<fs::path> files;
+    for (auto& file : getLogFiles(arguments)) {
+        if (soldy::CodecFromPath(file) == Codec::None && fs::weakly_canonical(file, ec) != output_canonical) {
+            files.push_back(std::move(file));
+        }
+    }
+    sort(files.begin(), files.end());
+
+    const int maxThreads = arguments.GetCountThread();
+    const size_t budget_mb = arguments.GetMemoryBudget();
+    const size_t budget = budget_mb ? budget_mb * 1024 * 1024 : MemoryBudget::DefaultCapacity();
+    //Половина доли потока - окна чтения EventReader
+    const size_t buffer_limit = (std::max)(budget / maxThreads / 2, static_cast<size_t>(1024 * 1024));
+
+    atomic<size_t> all_size{ 0 };
+    atomic<size_t> next_file{ 0 };
+    atomic<size_t> skipped{ 0 };
+    atomic<size_t> errors{ 0 };
+    auto start = chrono::high_resolution_clock::now();
+
+    vector<unique_ptr<TraceCollector>> collectors;
+    std::vector<std::future<size_t>> futures;
+    for (int i = 0; i < maxThreads; ++i) {
+        collectors.push_back(make_unique<TraceCollector>(run_dir, buffer_limit));
+        futures.push_back(std::async(std::launch::async,
+            [&files, &next_file, &all_size, &skipped, &errors, &root, &query, &cache, &signature, simd_level](TraceCollector& collector) -> size_t {
+                size_t matched = 0;
+                size_t thread_skipped = 0;
+                size_t thread_errors = 0;
+                for (size_t i = next_file++; i < files.size(); i = next_file++) {
+                    try {
+                        fs::path relative = fs::is_directory(root) ? files[i].lexically_relative(root) : files[i].filename();
+                        auto relative_u8 = relative.generic_u8string();
+                        all_size += traceFile(files[i], i, string(relative_u8.begin(), relative_u8.end()) + " ", query,
+                            cache ? &*cache : nullptr, signature, collector, simd_level, matched, thread_skipped, thread_errors);
+                    }
+                    catch (...) {
+                        ++thread_errors;
+                        lock_guard<mutex> lock(coutMutex);
+                        wcout << L"Error: file '" << files[i].wstring() << L"' not traced" << endl;
+                    }
+                }
+                skipped += thread_skipped;
+                errors += thread_errors;
+                error_code finish_ec;
+                if (!collector.Finish(finish_ec)) {
+                    ++errors;
+                    lock_guard<mutex> lock(coutMutex);
+                    wcout << L"Error: trace buffer not saved (" << error_str(finish_ec) << L")" << endl;
+                }
+                return matched;
+            }, std::ref(*collectors.back())));
+    }
+
+    size_t matched = 0;
+    for (auto& future : futures) {
+        matched += future.get();
+    }
+
+    vector<fs::path> runs;
+    for (const auto& collector : collectors) {
+        runs.insert(runs.end(), collector->Runs().begin(), collector->Runs().end());
+    }
+    size_t events = 0;
+    if (!TraceCollector::Merge(runs, run_dir, output, events, ec)) {
+        wcout << L"Error: trace '" << output.wstring() << L"' not written (" << error_str(ec) << L")" << endl;
+        return 1;
+    }
+    fs::remove_all(run_dir, ec);
+
+    auto end = chrono::high_resolution_clock::now();
+    auto duration = chrono::duration_cast<chrono::microseconds>(end - start);
+
+    wcout << L"All in files: " << files.size() << L" (skipped by summary: " << skipped << L"), "
+        << all_size << L" bytes in " << duration.count() << L" microseconds; events: "
+        << events << L" (runs: " << runs.size() << L") -> '" << output.wstring() << L"'; errors: " << errors << endl;
+    return (errors || events != matched) ? 1 : 0;
+}
+
+//Удаление событий по правилу хранения из одного flat-журнала. output пустой - на месте
+bool compactFile(const fs::path& file, const fs::path& output, LogCompactor& compactor, bool dry_run, size_t& saved) {
+    auto start = chrono::high_resolution_clock::now();
+
+    //Файл текущего часа еще пишет сервер 1С: на месте его не сжимаем и с --include-active, и при -P на один файл
+    if (output.empty() && !dry_run && LogDiscovery::HourOf(file) == LogDiscovery::ActiveHour()) {
+        lock_guard<mutex> lock(coutMutex);
+        wcout << L"Error: file '" << file.wstring() << L"' of the current hour not compacted in place, specify '--out'" << endl;
+        return false;
+    }
+    error_code ec;
+    if (!output.empty() && !dry_run) {
+        fs::create_directories(output.parent_path(), ec);
+    }
+    if (ec || !compactor.Compact(file, output, dry_run, ec)) {
+        lock_guard<mutex> lock(coutMutex);
+        wcout << L"Error: file '" << file.wstring() << L"' not compacted (" << error_str(ec) << L")" << endl;
+        return false;
+    }
+    //Смещения, сводка и хеш исходного файла после удаления событий неверны
+    if (output.empty() && !dry_run && compactor.OutputSize() != compactor.InputSize()) {
+        fs::remove(EventIndex::SidecarPath(file), ec);
+        fs::remove(FileSummary::SidecarPath(file), ec);
+        fs::remove(LogHash::SidecarPath(file), ec);
+        fs::remove_all(EventStore::StorePath(file), ec);
+    }
+    saved += compactor.InputSize() - compactor.OutputSize();
+
+    auto end = chrono::high_resolution_clock::now();
+    auto duration = chrono::duration_cast<chrono::microseconds>(end - start);
+
+    lock_guard<mutex> lock(coutMutex);
+    wcout << L"file '" << file.wstring() << L"': " << compactor.InputSize() << L" -> " << compactor.OutputSize()
+        << L" bytes" << (dry_run ? L" (dry run)" : L"") << L", dropped events: " << compactor.DroppedEvents()
+        << L" of " << compactor.Events() << L" in " << duration.count() << L" microseconds" << endl;
+    return true;
+}
+
+//Режим compact: в журналах остаются только нужные события. Сжатые журналы пропускаются
+int compactLogs(const ArgumentParser& arguments, SimdSupport::SimdLevel simd_level) {
+    RetentionRule rule;
+    if (!RetentionRule::Parse(arguments.GetDrop(), rule)) {
+        wcout << "Error: specify the events to remove '--drop' for compact mode." << endl;
+        return 0;
+    }
+
+    LogDiscovery discovery(arguments.GetPath(), getDiscoveryFilter(arguments));
+    if (!startDiscovery(discovery, arguments.GetPath())) {
+        return 0;
+    }
+    const fs::path root(arguments.GetPath());
+    const fs::path out_dir(arguments.GetOut());
+    const bool dry_run = arguments.IsDryRun();
+
+    atomic<size_t> all_size{ 0 };
+    atomic<size_t> all_saved{ 0 };
+    atomic<size_t> errors{ 0 };
+    auto start = chrono::high_resolution_clock::now();
+
+    processFiles(discovery, arguments, errors, [&rule, &root, &out_dir, &all_size, &all_saved, &errors, dry_run, simd_level]() {
+        return [&root, &out_dir, &all_size, &all_saved, &errors, dry_run, compactor = LogCompactor(rule, simd_level)](const fs::path& file) mutable {
+            fs::path output;
+            if (!out_dir.empty()) {
+                output = out_dir / (fs::is_directory(root) ? file.lexically_relative(root) : file.filename());
+            }
+            size_t saved = 0;
+            if (soldy::CodecFromPath(file) != Codec::None) {
+                lock_guard<mutex> lock(coutMutex);
+                wcout << L"file '" << file.wstring() << L"' is compressed, skipping" << endl;
+            }
+            else if (compactFile(file, output, compactor, dry_run, saved)) {
+                all_size += compactor.InputSize();
+                all_saved += saved;
+            }
+            else {
+                ++errors;
+            }
+        };
+    });
+
+    auto end = chrono::high_resolution_clock::now();
+    auto duration = chrono::duration_cast<chrono::microseconds>(end - start);
+
+    wcout << L"All in files: " << all_size << L" bytes in " << duration.count() << L" microseconds; removed: "
+        << all_saved << L" bytes, errors: " << errors << endl;
+    return errors ? 1 : 0;
+}
+
+//Режим split: файлы больше --part-size делятся на части по началам событий для параллельной загрузки.
+//Сначала строятся планы (несколько чтений около границ), затем части копируются параллельно,
+//поэтому один большой файл делят все потоки
+int splitLogs(const ArgumentParser& arguments, SimdSupport::SimdLevel simd_level) {
+    const fs::path out_dir(arguments.GetOut());
+    if (out_dir.empty()) {
+        wcout << "Error: the '-O [--out]' parameter is empty. Specify the output directory for split mode." << endl;
+        return 0;
+    }
+    const fs::path root(arguments.GetPath());
+    const size_t part_size = arguments.GetPartSize() * 1024 * 1024;
+    vector<fs::path> files;
+    for (auto& file : getLogFiles(arguments)) {
+        if (soldy::CodecFromPath(file) == Codec::None) {
+            files.push_back(std::move(file));
+        }
+    }
+
+    struct Part {
+        size_t file;
+        size_t number;
+        size_t begin;
+        size_t end;
+        bool add_bom;
+    };
+    vector<Part> parts;
+    mutex parts_mutex;
+    atomic<size_t> next{ 0 };
+    atomic<size_t> all_size{ 0 };
+    atomic<size_t> kernel_size{ 0 };
+    atomic<size_t> not_split{ 0 };
+    atomic<size_t> errors{ 0 };
+    auto start = chrono::high_resolution_clock::now();
+
+    std::vector<std::future<void>> futures;
+    for (int i = 0; i < arguments.GetCountThread(); ++i) {
+        futures.push_back(std::async(std::launch::async,
+            [&files, &parts, &parts_mutex, &next, &all_size, &not_split, &errors, part_size, simd_level]() {
+                LogSplitter splitter(simd_level);
+                vector<size_t> bounds;
+                for (size_t i = next++; i < files.size(); i = next++) {
+                    error_code ec;
+                    bool has_bom = false;
+                    if (!splitter.Plan(files[i], part_size, bounds, has_bom, ec)) {
+                        ++errors;
+                        lock_guard<mutex> lock(coutMutex);
+                        wcout << L"Error: file '" << files[i].wstring() << L"' not split (" << error_str(ec) << L")" << endl;
+                        continue;
+                    }
+                    //Файл из одной части не копируется в --out
+                    if (bounds.size() <= 2) {
+                        ++not_split;
+                        lock_guard<mutex> lock(coutMutex);
+                        wcout << L"file '" << files[i].wstring() << L"': smaller than --part-size, not split" << endl;
+                        continue;
+                    }
+                    all_size += bounds.back();
+                    lock_guard<mutex> lock(parts_mutex);
+                    for (size_t k = 1; k < bounds.size(); ++k) {
+                        parts.push_back({ i, k, bounds[k - 1], bounds[k], has_bom && k > 1 });
+                    }
+                }
+            }));
+    }
+    for (auto& future : futures) {
+        future.get();
+    }
+
+    futures.clear();
+    next = 0;
+    for (int i = 0; i < arguments.GetCountThread(); ++i) {
+        futures.push_back(std::async(std::launch::async,
+            [&files, &parts, &next, &kernel_size, &errors, &root, &out_dir]() {
+                for (size_t i = next++; i < parts.size(); i = next++) {
+                    const Part& part = parts[i];
+                    const fs::path& file = files[part.file];
+                    auto part_start = chrono::high_resolution_clock::now();
+
+                    //Часть k файла <каталог>/<файл> - <out>/<каталог>.k/<файл>: имя YYMMDDHH.log сохраняется
+                    const fs::path relative = fs::is_directory(root) ? file.lexically_relative(root) : file.filename();
+                    const wstring number = to_wstring(part.number);
+                    const fs::path dir = out_dir / (relative.parent_path().empty() ? number : relative.parent_path().wstring() + L"." + number);
+                    const fs::path output = dir / relative.filename();
+                    error_code ec;
+                    size_t kernel_copied = 0;
+                    fs::create_directories(dir, ec);
+                    if (ec || !LogSplitter::CopyRange(file, part.begin, part.end, output, part.add_bom, kernel_copied, ec)) {
+                        ++errors;
+                        lock_guard<mutex> lock(coutMutex);
+                        wcout << L"Error: part '" << output.wstring() << L"' not written (" << error_str(ec) << L")" << endl;
+                        continue;
+                    }
+                    kernel_size += kernel_copied;
+
+                    auto part_end = chrono::high_resolution_clock::now();
+                    auto duration = chrono::duration_cast<chrono::microseconds>(part_end - part_start);
+
+                    lock_guard<mutex> lock(coutMutex);
+                    wcout << L"file '" << file.wstring() << L"' [" << part.begin << L", " << part.end << L") -> '"
+                        << output.wstring() << L"' in " << duration.count() << L" microseconds" << endl;
+                }
+            }));
+    }
+    for (auto& future : futures) {
+        future.get();
+    }
+
+    auto end = chrono::high_resolution_clock::now();
+    auto duration = chrono::duration_cast<chrono::microseconds>(end - start);
+
+    wcout << L"All in files: " << all_size << L" bytes in " << duration.count() << L" microseconds; parts: " << parts.size()
+        << L", not split: " << not_split << L", copied in kernel: " << kernel_size << L" bytes, errors: " << errors << endl;
+    return errors ? 1 : 0;
+}
+
+//Режим show: события flat-журнала в исходном виде. Файл открывается только для чтения, преобразуются
+//только показанные события. События пишутся в stdout (или --out) как есть, сообщения - в stderr
+int showLogs(const ArgumentParser& arguments, SimdSupport::SimdLevel simd_level) {
+    const fs::path file(arguments.GetPath());
+    vector<pair<uint64_t, uint64_t>> ranges;
+    for (const auto& item : arguments.GetEvent()) {
+        const size_t dash = item.find(L'-');
+        ranges.emplace_back(stoull(item.substr(0, dash)), stoull(dash == wstring::npos ? item : item.substr(dash + 1)));
+    }
+    vector<uint64_t> offsets;
+    for (const auto& item : arguments.GetOffset()) {
+        offsets.push_back(stoull(item));
+    }
+    TraceQuery query(simd_level);
+    for (const auto& value : arguments.GetSession()) {
+        query.Add("SessionID", string(value.begin(), value.end()));
+    }
+    for (const auto& value : arguments.GetConnect()) {
+        query.Add("t:connectID", string(value.begin(), value.end()));
+    }
+    if (ranges.empty() && offsets.empty() && query.Empty()) {
+        wcerr << L"Error: specify '--event', '--offset', '--session' or '--connect' for show mode." << endl;
+        return 1;
+    }
+
+    error_code ec;
+    LogView view(simd_level);
+    if (fs::is_directory(file, ec) || !view.Open(file, ec)) {
+        wcerr << L"Error: file '" << file.wstring() << L"' not open (" << (ec ? error_str(ec) : L"show mode expects a file") << L")" << endl;
+        return 1;
+    }
+    ofstream out_file;
+    if (!arguments.GetOut().empty()) {
+        out_file.open(fs::path(arguments.GetOut()), ios::binary | ios::trunc);
+        if (!out_file) {
+            wcerr << L"Error: file '" << arguments.GetOut() << L"' not created" << endl;
+            return 1;
+        }
+    }
+#ifdef _WIN32
+    else {
+        _setmode(_fileno(stdout), _O_BINARY);
+    }
+#endif
+    ostream& out = out_file.is_open() ? static_cast<ostream&>(out_file) : cout;
+
+    auto start = chrono::high_resolution_clock::now();
+    size_t events = 0;
+    size_t bytes = 0;
+    auto visit = [&out, &events, &bytes](uint64_t, uint64_t, string_view text) {
+        out.write(text.data(), static_cast<streamsize>(text.size()));
+        ++events;
+        bytes += text.size();
+        return static_cast<bool>(out);
+    };
+
+    bool is_ok = ranges.empty() || view.ReadNumbers(ranges, visit, ec);
+    for (size_t i = 0; is_ok && i < offsets.size(); ++i) {
+        is_ok = view.ReadAt(offsets[i], visit, ec);
+    }
+    is_ok = is_ok && (query.Empty() || view.ReadMatching(query, visit, ec));
+    out.flush();
+    if (!is_ok || !out) {
+        wcerr << L"Error: events of file '" << file.wstring() << L"' not shown (" << (ec ? error_str(ec) : L"write error") << L")" << endl;
+        return 1;
+    }
+
+    auto end = chrono::high_resolution_clock::now();
+    auto duration = chrono::duration_cast<chrono::microseconds>(end - start);
+    wcerr << L"Shown events: " << events << L", " << bytes << L" bytes in " << duration.count() << L" microseconds" << endl;
+    return 0;
+}
+
+bool buildStore(const fs::path& file, StoreBuilder& builder, SimdSupport::SimdLevel simd_level, bool& up_to_date) {
+    auto start = chrono::high_resolution_clock::now();
+
+    //Хранилище того же размера файла и с теми же столбцами не перестраивается.
+    //Проверенное хранилище закрывается до перестроения: в Windows отображенный файл не удалить
+    error_code ec;
+    {
+        EventStore store(simd_level);
+        up_to_date = store.Open(file, ec) && store.Properties() == builder.Properties();
+    }
+    if (up_to_date) {
+        return true;
+    }
+    ec.clear();
+    if (!builder.Build(file, hourTime(file), ec)) {
+        lock_guard<mutex> lock(coutMutex);
+        wcout << L"Error: store of file '" << file.wstring() << L"' not built (" << error_str(ec) << L")" << endl;
+        return false;
+    }
+
+    auto end = chrono::high_resolution_clock::now();
+    auto duration = chrono::duration_cast<chrono::microseconds>(end - start);
+
+    lock_guard<mutex> lock(coutMutex);
+    wcout << L"file '" << file.wstring() << L"': " << builder.SourceSize() << L" bytes, events: " << builder.Events()
+        << L", store: " << builder.StoreSize() << L" bytes in " << duration.count() << L" microseconds" << endl;
+    return true;
+}
+
+//Режим build-store: столбцовое хранилище <файл>.store для запросов без разбора текста. Сжатые журналы пропускаются
+int buildStoreLogs(const ArgumentParser& arguments, SimdSupport::SimdLevel simd_level) {
+    vector<string> properties;
+    for (const auto& column : arguments.GetColumns()) {
+        properties.emplace_back(column.begin(), column.end());
+    }
+    if (properties.empty()) {
+        properties = EventStore::DefaultProperties();
+    }
+
+    LogDiscovery discovery(arguments.GetPath(), getDiscoveryFilter(arguments));
+    if (!startDiscovery(discovery, arguments.GetPath())) {
+        return 0;
+    }
+    atomic<size_t> all_size{ 0 };
+    atomic<size_t> store_size{ 0 };
+    atomic<size_t> up_to_date{ 0 };
+    atomic<size_t> errors{ 0 };
+    auto start = chrono::high_resolution_clock::now();
+
+    processFiles(discovery, arguments, errors, [&properties, &all_size, &store_size, &up_to_date, &errors, simd_level]() {
+        return [&all_size, &store_size, &up_to_date, &errors, simd_level, builder = StoreBuilder(properties, simd_level)](const fs::path& file) mutable {
+            bool is_up_to_date = false;
+            if (soldy::CodecFromPath(file) != Codec::None) {
+                lock_guard<mutex> lock(coutMutex);
+                wcout << L"file '" << file.wstring() << L"' is compressed, skipping" << endl;
+            }
+            else if (!buildStore(file, builder, simd_level, is_up_to_date)) {
+                ++errors;
+            }
+            else if (is_up_to_date) {
+                ++up_to_date;
+            }
+            else {
+                all_size += builder.SourceSize();
+                store_size += builder.StoreSize();
+            }
+        };
+    });
+
+    auto end = chrono::high_resolution_clock::now();
+    auto duration = chrono::duration_cast<chrono::microseconds>(end - start);
+
+    wcout << L"All in files: " << all_size << L" bytes in " << duration.count() << L" microseconds; stores: "
+        << store_size << L" bytes, up to date: " << up_to_date << L", errors: " << errors << endl;
+    return errors ? 1 : 0;
+}
+
+//YYMMDDHHMMSS -> микросекунды в шкале hourTime
+uint64_t queryTime(const wstring& value) {
+    return stoull(value.substr(0, 8)) * 3600ULL * 1000000ULL
+        + (stoull(value.substr(8, 2)) * 60 + stoull(value.substr(10, 2))) * 1000000ULL;
+}
+
+//Строки событий файла, подходящих под запрос: файл, смещение, час, MM:SS.ffffff, длительность, событие, свойства
+bool queryStore(const fs::path& file, const EventStore::Query& query, SimdSupport::SimdLevel simd_level, string& lines,
+    size_t& events, size_t& matched, error_code& ec) {
+    EventStore store(simd_level);
+    if (!store.Open(file, ec)) {
+        return false;
+    }
+    vector<uint64_t> rows;
+    if (!store.Select(query, rows, ec)) {
+        return false;
+    }
+    const auto file_u8 = file.u8string();
+    const string file_name(file_u8.begin(), file_u8.end());
+    char line[128];
+    for (uint64_t row : rows) {
+        const uint64_t time = store.Time(row) - store.HourTime();
+        snprintf(line, sizeof(line), " %llu %08llu %02llu:%02llu.%06llu %llu ", static_cast<unsigned long long>(store.Offset(row)),
+            static_cast<unsigned long long>(store.HourTime() / (3600ULL * 1000000ULL)), static_cast<unsigned long long>(time / 60000000ULL),
+            static_cast<unsigned long long>(time / 1000000ULL % 60), static_cast<unsigned long long>(time % 1000000ULL),
+            static_cast<unsigned long long>(store.Duration(row)));
+        lines.append(file_name).append(line).append(store.Event(row));
+        for (size_t i = 0; i < store.Properties().size(); ++i) {
+            const string& value = store.Property(i, row);
+            if (!value.empty()) {
+                lines.append(",").append(store.Properties()[i]).append("=").append(value);
+            }
+        }
+        lines.append("\n");
+    }
+    events += store.Events();
+    matched += rows.size();
+    return true;
+}
+
+//Режим query: события из хранилищ build-store по имени, длительности, интервалу времени и свойствам.
+//Читаются только столбцы условий и подходящие строки, текст журналов не разбирается.
+//Вывод - данные, поэтому без строки параметров запуска, сообщения - в stderr
+int queryLogs(const ArgumentParser& arguments, SimdSupport::SimdLevel simd_level) {
+    EventStore::Query query;
+    for (const auto& name : arguments.GetName()) {
+        query.names.emplace_back(name.begin(), name.end());
+    }
+    query.min_duration = arguments.GetMinDuration();
+    if (!arguments.GetFrom().empty()) {
+        query.from = queryTime(arguments.GetFrom());
+    }
+    if (!arguments.GetTo().empty()) {
+        query.to = queryTime(arguments.GetTo());
+    }
+    auto add_property = [&query](const string& property, const vector<wstring>& values) {
+        if (!values.empty()) {
+            query.properties.emplace_back(property, vector<string>());
+            for (const auto& value : values) {
+                query.properties.back().second.emplace_back(value.begin(), value.end());
+            }
+        }
+    };
+    add_property("SessionID", arguments.GetSession());
+    add_property("t:connectID", arguments.GetConnect());
+    if (query.names.empty() && !query.min_duration && arguments.GetFrom().empty() && arguments.GetTo().empty() && query.properties.empty()) {
+        wcerr << L"Error: specify '--name', '--min-duration', '--from', '--to', '--session' or '--connect' for query mode." << endl;
+        return 1;
+    }
+
+    ofstream out_file;
+    if (!arguments.GetOut().empty()) {
+        out_file.open(fs::path(arguments.GetOut()), ios::binary | ios::trunc);
+        if (!out_file) {
+            wcerr << L"Error: file '" << arguments.GetOut() << L"' not created" << endl;
+            return 1;
+        }
+    }
+#ifdef _WIN32
+    else {
+        _setmode(_fileno(stdout), _O_BINARY);
+    }
+#endif
+    ostream& out = out_file.is_open() ? static_cast<ostream&>(out_file) : cout;
+
+    LogDiscovery discovery(arguments.GetPath(), getDiscoveryFilter(arguments));
+    error_code discovery_ec;
+    if (!discovery.Start(discovery_ec)) {
+        wcerr << L"Error: could not retrieve log files from '" << arguments.GetPath() << L"' (" << error_str(discovery_ec) << L")" << endl;
+        return 1;
+    }
+    atomic<size_t> files{ 0 };
+    atomic<size_t> no_store{ 0 };
+    atomic<size_t> all_events{ 0 };
+    atomic<size_t> all_matched{ 0 };
+    atomic<size_t> errors{ 0 };
+    auto start = chrono::high_resolution_clock::now();
+
+    processFiles(discovery, arguments, errors, [&query, &out, &files, &no_store, &all_events, &all_matched, &errors, simd_level]() {
+        return [&query, &out, &files, &no_store, &all_events, &all_matched, &errors, simd_level, lines = string()](const fs::path& file) mutable {
+            ++files;
+            error_code ec;
+            size_t events = 0;
+            size_t matched = 0;
+            lines.clear();
+            if (!fs::exists(EventStore::StorePath(file), ec)) {
+                ++no_store;
+            }
+            else if (!queryStore(file, query, simd_level, lines, events, matched, ec)) {
+                ++errors;
+                lock_guard<mutex> lock(coutMutex);
+                wcerr << L"Error: store of file '" << file.wstring() << L"' not queried, the file changed or the store has no column "
+                    << L"of '--session'/'--connect': rebuild it with build-store mode (" << error_str(ec) << L")" << endl;
+            }
+            else {
+                all_events += events;
+                all_matched += matched;
+                lock_guard<mutex> lock(coutMutex);
+                out.write(lines.data(), static_cast<streamsize>(lines.size()));
+            }
+        };
+    });
+    out.flush();
+    if (!out) {
+        wcerr << L"Error: query result not written" << endl;
+        return 1;
+    }
+
+    auto end = chrono::high_resolution_clock::now();
+    auto duration = chrono::duration_cast<chrono::microseconds>(end - start);
+    wcerr << L"Files: " << files << L" (without store: " << no_store << L"), events: " << all_events << L", matched: "
+        << all_matched << L" in " << duration.count() << L" microseconds; errors: " << errors << endl;
+    return errors ? 1 : 0;
 }
 
 #ifdef _WIN32
@@ -152,48 +1426,173 @@ int main(int argc, char* argv[], char* envp[]) {
         return 0;
     }
 
+    //План частей строится по списку файлов, и у всех процессов он должен совпасть. Список не должен меняться
+    //со временем: верхняя граница --until не позже текущего часа, активный час в обработку не попадает
+    if (!arguments.GetShard().empty()) {
+        if (arguments.GetUntil().empty() || arguments.GetUntil() > LogDiscovery::ActiveHour()) {
+            wcout << L"Error: the '--shard' parameter requires '--until' not later than the current hour." << endl;
+            return 0;
+        }
+        if (arguments.IsIncludeActive()) {
+            wcout << L"Error: the '--shard' parameter cannot be used with '--include-active'." << endl;
+            return 0;
+        }
+    }
+
     SimdSupport::SimdLevel simd_level = getSimdLevel(arguments);
-    FlatLog::Mode mode = (arguments.GetMode() == L"flat" ? FlatLog::Mode::Flat : FlatLog::Mode::Unflat);
+
+    if (arguments.GetMode() == L"merge") {
+        printMode(arguments, simd_level);
+        return mergeLogs(arguments, simd_level);
+    }
+
+    if (arguments.GetMode() == L"verify") {
+        printMode(arguments, simd_level);
+        return verifyLogs(arguments, simd_level);
+    }
+
+    if (arguments.GetMode() == L"trace") {
+        printMode(arguments, simd_level);
+        return traceLogs(arguments, simd_level);
+    }
+
+    if (arguments.GetMode() == L"compact") {
+        printMode(arguments, simd_level);
+        return compactLogs(arguments, simd_level);
+    }
+
+    //Вывод show - содержимое событий, поэтому без строки параметров запуска
+    if (arguments.GetMode() == L"show") {
+        return showLogs(arguments, simd_level);
+    }
+
+    if (arguments.GetMode() == L"build-store") {
+        printMode(arguments, simd_level);
+        return buildStoreLogs(arguments, simd_level);
+    }
+
+    //Как и show, query выводит данные
+    if (arguments.GetMode() == L"query") {
+        return queryLogs(arguments, simd_level);
+    }
+
+    if (arguments.GetMode() == L"split") {
+        printMode(arguments, simd_level);
+        return splitLogs(arguments, simd_level);
+    }
+
+    int maxThreads = arguments.GetCountThread();
+
+    //Сжатие переименовывает файлы, и план в процессах, запущенных позже, получился бы другим
+    if (!arguments.GetShard().empty() && !arguments.GetCompress().empty()) {
+        wcout << L"Error: the '--shard' parameter cannot be used with '--compress'." << endl;
+        return 0;
+    }
+
+    //Приоритет понижается до запуска потоков обработки, они его наследуют
+    if (arguments.GetNice() || !arguments.GetIoPriority().empty()) {
+        error_code ec;
+        if (!Throttle::LowerPriority(arguments.GetNice(), arguments.GetIoPriority(), ec)) {
+            wcout << L"Warning: priority not lowered (" << error_str(ec) << L")" << endl;
+        }
+    }
+    Throttle throttle(arguments.GetMaxIo(), arguments.GetMaxCpu());
+
+    //Общий бюджет спроецированной памяти; размер региона по умолчанию делит его между потоками
+    const size_t budget_mb = arguments.GetMemoryBudget();
+    MemoryBudget memory_budget(budget_mb ? budget_mb * 1024 * 1024 : MemoryBudget::DefaultCapacity());
+
+    ConvertOptions options;
+    options.mode = (arguments.GetMode() == L"flat" ? FlatLog::Mode::Flat : FlatLog::Mode::Unflat);
+    options.chank_size = arguments.GetChank() ? arguments.GetChank() * 1024 * 1024 * 1024
+        : MemoryBudget::AutoRegionSize(memory_budget.Capacity(), maxThreads);
+    options.thread_count = arguments.GetChank() ? 0 : maxThreads;
+    options.simd_level = simd_level;
+    options.compress = arguments.GetCompress();
+    options.memory_budget = &memory_budget;
+    options.drop_cache = arguments.IsDropCache();
+    options.throttle = throttle.IsLimited() ? &throttle : nullptr;
+    options.record_hash = arguments.IsRecordHash();
+    options.dry_run = arguments.IsDryRun();
+    options.build_index = arguments.IsIndex();
+    options.build_summary = arguments.IsSummary();
+    EventCounter stats;
+    options.stats = arguments.IsStats() ? &stats : nullptr;
+    optional<ResultCache> cache;
+    if (!arguments.GetCache().empty()) {
+        cache.emplace(arguments.GetCache());
+        options.cache = &*cache;
+    }
     
     wcout << L"SIMD: " << SimdSupport::SimdLevelToString(simd_level)
-        << L"; Chank: " << arguments.GetChank() << L"GB"
+        << L"; Chank: " << options.chank_size / (1024 * 1024) << L"MB"
+        << L"; Memory: " << memory_budget.Capacity() / (1024 * 1024) << L"MB"
         << L"; Mode=" << arguments.GetMode() << L";"
         << L"Thread=" << arguments.GetCountThread() << endl;
 
     atomic<size_t> all_size{ 0 };
     auto start = chrono::high_resolution_clock::now();
 
-    vector<fs::path> files = getLogFiles(path);
-    const size_t chank_size = arguments.GetChank() * 1024 * 1024 * 1024;
-
-    int maxThreads = arguments.GetCountThread();
-    counting_semaphore<> semaphore(maxThreads);
-    std::vector<std::future<size_t>> futures;
-    for (const auto& file : files) {
-        semaphore.acquire();
-
-        futures.push_back(std::async(std::launch::async,
-            [&semaphore, &all_size, file, mode, chank_size, simd_level]() -> size_t {
-                try {
-                    size_t size = convertFile(file, mode, chank_size, simd_level);
-                    all_size += size;
-                    semaphore.release();
-                    return size;
-                }
-                catch (...) {
-                    semaphore.release();
-                    return 0;
-                }
-            }));
+    //Файлы обрабатываются по мере обнаружения, не дожидаясь окончания обхода каталогов
+    LogDiscovery discovery(path, getDiscoveryFilter(arguments));
+    if (!startDiscovery(discovery, path)) {
+        return 0;
     }
 
-    for (auto& future : futures) {
-        future.get();
+    //При --shard нужен полный список файлов: план строится по всем файлам одинаково в каждом процессе
+    const auto shard_plan = getShardPlan(arguments);
+    vector<ShardPlan::FileRange> ranges;
+    if (shard_plan) {
+        error_code ec;
+        ranges = shard_plan->Assign(discovery.Collect(), path, ec);
+        if (ec) {
+            wcout << L"Error: shard plan not built (" << error_str(ec) << L")" << endl;
+            return 0;
+        }
     }
+    atomic<size_t> errors{ 0 };
+    ChangeTotals totals;
+    auto feed = [&discovery, &shard_plan, &ranges](DeviceScheduler<ShardPlan::FileRange>& scheduler) {
+        if (shard_plan) {
+            for (const auto& range : ranges) {
+                scheduler.Push(soldy::DeviceOf(range.path), range);
+            }
+        }
+        else {
+            ShardPlan::FileRange range;
+            while (discovery.Next(range.path)) {
+                scheduler.Push(soldy::DeviceOf(range.path), range);
+            }
+        }
+    };
+    processFiles<ShardPlan::FileRange>(arguments, errors, feed, [&all_size, &totals, &errors, &options]() {
+        return [&all_size, &totals, &errors, &options](const ShardPlan::FileRange& range) {
+            size_t size = 0;
+            FlatLog::Changes changes;
+            if (!convertFile(range, options, size, changes)) {
+                ++errors;
+                return;
+            }
+            all_size += size;
+            //Пропущенный пустой файл в итог не входит
+            if (size) {
+                totals.Add(range, changes);
+            }
+        };
+    });
 
     auto end = chrono::high_resolution_clock::now();
     auto duration = chrono::duration_cast<chrono::microseconds>(end - start);
 
-    wcout << L"All in files: " << all_size << L" bytes in " << duration.count() << L" microseconds" << endl;
-    return 0;
+    wcout << L"All in files: " << all_size << L" bytes in " << duration.count() << L" microseconds; "
+        << (options.dry_run ? L"would change LF: " : L"changed LF: ") << totals.lf << L", CR: " << totals.cr
+        << L", files without changes: " << totals.UnchangedFiles() << L", errors: " << errors;
+    if (options.throttle) {
+        wcout << L" (throttled " << throttle.Throttled().count() << L" microseconds)";
+    }
+    wcout << endl;
+    if (options.stats) {
+        printStats(stats);
+    }
+    return errors ? 1 : 0;
 }
\ No newline at end of file
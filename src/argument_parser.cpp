@@ -1,4 +1,6 @@
 ﻿#include "argument_parser.h"
+#include "shard_plan.h"
+#include "retention_rule.h"
 
 namespace soldy {
 
@@ -45,10 +47,87 @@ namespace soldy {
 			L"All options:\n"
 			L"  -P [ --path   ] arg          Full path to the directory with logs or log file.\n"
 			L"  -T [ --thread ] arg (=1)     Number of file processing threads.\n"
-			L"  -C [ --chank  ] arg (=4)     The chunk size in gigabytes when mapping a file into memory.\n"
-			L"                               Available values : 1, 2, 4, 8, 16, 32, 64, 128, 256.\n"
+			L"  -C [ --chank  ] arg (=auto)  The chunk size in gigabytes when mapping a file into memory.\n"
+			L"                               Available values : auto, 1, 2, 4, 8, 16, 32, 64, 128, 256.\n"
+			L"                               auto - the memory budget divided by the number of threads.\n"
+			L"  --mem-budget arg             Total size in megabytes of the file regions mapped by all threads\n"
+			L"                               at the same time, a quarter of RAM by default.\n"
+			L"  --drop-cache arg (=yes)      Drop processed regions from the OS file cache: yes, no.\n"
+			L"  --max-io arg                 Limit of the file read speed in MB/s shared by all threads,\n"
+			L"                               changes are written to disk at the same pace.\n"
+			L"  --max-cpu arg                Limit of the CPU load in percent of one core shared by all threads\n"
+			L"                               (200 - two cores).\n"
+			L"  --per-device arg             Limit of files of one disk processed at the same time (1-2 for HDD).\n"
+			L"                               Threads always take files from the least loaded disk.\n"
+			L"  --nice arg                   Lower the process priority: 1-19 (Windows: below normal, 10+ - idle).\n"
+			L"  --ioprio arg                 Lower the I/O priority: low, idle (Windows: background mode).\n"
 			L"  -M [ --mode   ] arg (=flat)  Launch mode, flat - replace line breaks in a multi-line event with\n"
-			L"                               service characters, unflat - reverse transformation.\n"
+			L"                               service characters, unflat - reverse transformation,\n"
+			L"                               merge - merge the logs of all processes for each hour into one\n"
+			L"                               time-ordered flat log in the '--out' directory,\n"
+			L"                               verify - read-only check that unflat restores the original file:\n"
+			L"                               compares the hash of the unflat view with the one saved by '--record-hash',\n"
+			L"                               trace - collect the events of the sessions '--session' and connections\n"
+			L"                               '--connect' from all files into one time-ordered file '--out',\n"
+			L"                               compact - remove the events '--drop' from flat logs in place (or write\n"
+			L"                               the rest to the '--out' directory) and truncate the files,\n"
+			L"                               split - cut files larger than '--part-size' into parts at event starts,\n"
+			L"                               part k of <dir>/<file> is written to '--out'/<dir>.k/<file>,\n"
+			L"                               smaller files are reported and not copied,\n"
+			L"                               show - print events '--event', '--offset' or of '--session'/'--connect'\n"
+			L"                               of the flat log '--path' in the original form, the file is not changed,\n"
+			L"                               build-store - build the columnar store <file>.store of each flat log: time,\n"
+			L"                               duration, event name, offset, process and the properties '--columns',\n"
+			L"                               query - print the events of the stores matching all of '--name',\n"
+			L"                               '--min-duration', '--from'/'--to', '--session'/'--connect' (one line\n"
+			L"                               per event: file, offset for '--offset' of show mode, time, duration, event).\n"
+			L"  --record-hash                Save the hash of the original file to <file>.hash when flattening.\n"
+			L"  --dry-run                    Open files read-only and only count the line breaks that would change\n"
+			L"                               (flat and unflat modes), nothing is written.\n"
+			L"  --index                      Save the offsets of all events to <file>.idx in the same pass over\n"
+			L"                               the file (flat and unflat modes, not for compressed logs).\n"
+			L"  --stats                      Count events and their total duration by event name in the same pass\n"
+			L"                               over the file (flat and unflat modes, not for compressed logs).\n"
+			L"  --summary                    Save a summary of the file to <file>.sum in the same pass: a Bloom filter\n"
+			L"                               over SessionID, t:connectID, t:clientID, Usr and event names, min/max time.\n"
+			L"                               Trace mode skips files whose summary rules out the searched values.\n"
+			L"  --cache arg                  Directory of the result cache: results of '--dry-run' (with '--stats')\n"
+			L"                               and trace mode are saved per file and reused while the file is unchanged\n"
+			L"                               (same inode, size and modification time).\n"
+			L"  --compress arg               Compression of the result: none, gzip, zstd. By default the format of\n"
+			L"                               the source file is kept (*.log.gz, *.log.zst are processed as a stream).\n"
+			L"  --since arg                  Process only logs from the hour YYMMDDHH inclusive.\n"
+			L"  --until arg                  Process only logs before the hour YYMMDDHH.\n"
+			L"  --filter-by arg (=name)      What '--since'/'--until' are compared with: name - the hour in the\n"
+			L"                               file name YYMMDDHH.log, mtime - the file modification time.\n"
+			L"  --include arg                Process only files whose path relative to '--path' matches one of the\n"
+			L"                               comma-separated patterns (* and ? are allowed).\n"
+			L"  --exclude arg                Skip files whose relative path matches one of the patterns.\n"
+			L"  --include-active             Also process the file of the current hour (skipped by default,\n"
+			L"                               the 1C server is still writing it).\n"
+			L"  --shard arg                  Process only the part i/N of the logs (1/3, 2/3, 3/3), so that N processes\n"
+			L"                               on different machines can share one tree without coordination.\n"
+			L"                               Parts are balanced by size, merge mode splits the hours.\n"
+			L"                               All processes must see the same files: requires '--until' not later than\n"
+			L"                               the current hour, '--include-active' is not allowed.\n"
+			L"  --shard-split arg (=1024)    Files larger than this size in megabytes are split into parts (--shard).\n"
+			L"  --part-size arg (=1024)      Approximate size of a part in megabytes (split mode).\n"
+			L"  -O [ --out    ] arg          Output directory (merge, compact and split modes) or file (trace, show\n"
+			L"                               and query modes, stdout by default for show and query).\n"
+			L"  --session arg                Comma-separated values of SessionID to select (trace, show, query modes).\n"
+			L"  --connect arg                Comma-separated values of t:connectID to select (trace, show, query modes).\n"
+			L"  --drop arg                   Comma-separated events to remove (compact mode): NAME - all events,\n"
+			L"                               NAME<N - events with duration less than N, e.g. SCALL,CALL<1000.\n"
+			L"  --event arg                  Comma-separated numbers (from 0) or ranges N-M of events to show\n"
+			L"                               (show mode, <file>.idx is used when built by '--index').\n"
+			L"  --offset arg                 Comma-separated offsets of events to show (show mode).\n"
+			L"  --columns arg                Comma-separated properties stored as columns (build-store mode),\n"
+			L"                               p:processName,Usr,SessionID,t:connectID by default.\n"
+			L"  --name arg                   Comma-separated event names to query (query mode).\n"
+			L"  --min-duration arg           Query events with a duration not less than this (query mode).\n"
+			L"  --from arg                   Query events from the time YYMMDDHHMMSS inclusive (query mode).\n"
+			L"  --to arg                     Query events before the time YYMMDDHHMMSS (query mode).\n"
+			L"  --hour arg                   Hour to merge in the format YYMMDDHH, all hours by default (merge mode).\n"
 			L"  -S [ --simd   ] arg (=auto)  The option to use SIMD processor instructions.\n"
 			L"                               Possible values : auto, avx512, avx2, none.\n"
 			L"  -H [ --help   ]              Produce help message\n"
@@ -74,9 +153,150 @@ namespace soldy {
 		return get(L"simd", L"auto");
 	}
 
+	std::wstring ArgumentParser::GetOut() const {
+		return get(L"out");
+	}
+
+	std::wstring ArgumentParser::GetHour() const {
+		return get(L"hour");
+	}
+
+	std::wstring ArgumentParser::GetCompress() const {
+		return get(L"compress");
+	}
+
+	std::wstring ArgumentParser::GetSince() const {
+		return get(L"since");
+	}
+
+	std::wstring ArgumentParser::GetUntil() const {
+		return get(L"until");
+	}
+
+	std::wstring ArgumentParser::GetFilterBy() const {
+		return get(L"filter-by", L"name");
+	}
+
+	std::vector<std::wstring> ArgumentParser::GetInclude() const {
+		return getList(L"include");
+	}
+
+	std::vector<std::wstring> ArgumentParser::GetExclude() const {
+		return getList(L"exclude");
+	}
+
+	std::vector<std::wstring> ArgumentParser::GetSession() const {
+		return getList(L"session");
+	}
+
+	std::vector<std::wstring> ArgumentParser::GetConnect() const {
+		return getList(L"connect");
+	}
+
+	std::vector<std::wstring> ArgumentParser::GetEvent() const {
+		return getList(L"event");
+	}
+
+	std::vector<std::wstring> ArgumentParser::GetOffset() const {
+		return getList(L"offset");
+	}
+
+	std::vector<std::wstring> ArgumentParser::GetColumns() const {
+		return getList(L"columns");
+	}
+
+	std::vector<std::wstring> ArgumentParser::GetName() const {
+		return getList(L"name");
+	}
+
+	uint64_t ArgumentParser::GetMinDuration() const {
+		return std::stoull(get(L"min-duration", L"0"));
+	}
+
+	std::wstring ArgumentParser::GetFrom() const {
+		return get(L"from");
+	}
+
+	std::wstring ArgumentParser::GetTo() const {
+		return get(L"to");
+	}
+
+	std::wstring ArgumentParser::GetCache() const {
+		return get(L"cache");
+	}
+
+	std::wstring ArgumentParser::GetDrop() const {
+		return get(L"drop");
+	}
+
+	bool ArgumentParser::IsIncludeActive() const {
+		return arguments_.find(L"include-active") != arguments_.end();
+	}
+
+	bool ArgumentParser::IsDryRun() const {
+		return arguments_.find(L"dry-run") != arguments_.end();
+	}
+
+	bool ArgumentParser::IsRecordHash() const {
+		return arguments_.find(L"record-hash") != arguments_.end();
+	}
+
+	bool ArgumentParser::IsIndex() const {
+		return arguments_.find(L"index") != arguments_.end();
+	}
+
+	bool ArgumentParser::IsStats() const {
+		return arguments_.find(L"stats") != arguments_.end();
+	}
+
+	bool ArgumentParser::IsSummary() const {
+		return arguments_.find(L"summary") != arguments_.end();
+	}
+
 	size_t ArgumentParser::GetChank() const {
-		std::wstring chankw = get(L"chank", L"4");
-		return static_cast<size_t>(std::stoull(chankw));
+		std::wstring chankw = get(L"chank", L"auto");
+		return chankw == L"auto" ? 0 : static_cast<size_t>(std::stoull(chankw));
+	}
+
+	size_t ArgumentParser::GetMemoryBudget() const {
+		std::wstring budgetw = get(L"mem-budget", L"0");
+		return static_cast<size_t>(std::stoull(budgetw));
+	}
+
+	bool ArgumentParser::IsDropCache() const {
+		return get(L"drop-cache", L"yes") == L"yes";
+	}
+
+	size_t ArgumentParser::GetMaxIo() const {
+		return static_cast<size_t>(std::stoull(get(L"max-io", L"0")));
+	}
+
+	size_t ArgumentParser::GetMaxCpu() const {
+		return static_cast<size_t>(std::stoull(get(L"max-cpu", L"0")));
+	}
+
+	int ArgumentParser::GetNice() const {
+		return std::stoi(get(L"nice", L"0"));
+	}
+
+	std::wstring ArgumentParser::GetIoPriority() const {
+		return get(L"ioprio");
+	}
+
+	std::wstring ArgumentParser::GetShard() const {
+		return get(L"shard");
+	}
+
+	size_t ArgumentParser::GetShardSplit() const {
+		return static_cast<size_t>(std::stoull(get(L"shard-split", L"0")));
+	}
+
+	size_t ArgumentParser::GetPerDevice() const {
+		return static_cast<size_t>(std::stoull(get(L"per-device", L"0")));
+	}
+
+	size_t ArgumentParser::GetPartSize() const {
+		return static_cast<size_t>(std::stoull(get(L"part-size", L"1024")));
 	}
 
 	int ArgumentParser::GetCountThread() const {
@@ -104,7 +324,8 @@ namespace soldy {
 			}
 			else if (key == L"M" || key == L"mode") {
 				key = L"mode";
-				if (!(value == L"flat" || value == L"unflat")) {
+				if (!(value == L"flat" || value == L"unflat" || value == L"merge" || value == L"verify" || value == L"trace"
+					|| value == L"compact" || value == L"split" || value == L"show" || value == L"build-store" || value == L"query")) {
 					er.append(L"Invalid value '").append(value).append(L"' for parameter '- M[--mode]'.\n");
 					return false;
 				}
@@ -118,7 +339,7 @@ namespace soldy {
 			}
 			else if (key == L"C" || key == L"chank") {
 				key = L"chank";
-				if (!(value == L"1" || value == L"2" || value == L"4" || value == L"8" || value == L"16"
+				if (!(value == L"auto" || value == L"1" || value == L"2" || value == L"4" || value == L"8" || value == L"16"
 					|| value == L"32" || value == L"64" || value == L"128" || value == L"256")) {
 					er.append(L"Invalid value '").append(value).append(L"' for parameter '-C [--chank]'.\n");
 					return false;
@@ -126,6 +347,154 @@ namespace soldy {
 			}
 			else if (key == L"T" || key == L"thread") {
 				key = L"thread";
+				if (value.empty() || value.size() > 4 || !std::all_of(value.begin(), value.end(), [](wchar_t c) { return c >= L'0' && c <= L'9'; })
+					|| std::stoull(value) == 0) {
+					er.append(L"Invalid value '").append(value).append(L"' for parameter '-T [--thread]'.\n");
+					return false;
+				}
+			}
+			else if (key == L"O" || key == L"out") {
+				key = L"out";
+			}
+			else if (key == L"hour" || key == L"since" || key == L"until") {
+				if (value.size() != 8 || !std::all_of(value.begin(), value.end(), [](wchar_t c) { return c >= L'0' && c <= L'9'; })) {
+					er.append(L"Invalid value '").append(value).append(L"' for parameter '--").append(key).append(L"', expected YYMMDDHH.\n");
+					return false;
+				}
+			}
+			else if (key == L"from" || key == L"to") {
+				if (value.size() != 12 || !std::all_of(value.begin(), value.end(), [](wchar_t c) { return c >= L'0' && c <= L'9'; })) {
+					er.append(L"Invalid value '").append(value).append(L"' for parameter '--").append(key).append(L"', expected YYMMDDHHMMSS.\n");
+					return false;
+				}
+			}
+			else if (key == L"min-duration") {
+				if (value.empty() || value.size() > 18 || !std::all_of(value.begin(), value.end(), [](wchar_t c) { return c >= L'0' && c <= L'9'; })) {
+					er.append(L"Invalid value '").append(value).append(L"' for parameter '--min-duration'.\n");
+					return false;
+				}
+			}
+			else if (key == L"columns" || key == L"name") {
+				//Имена свойств и событий: без '=', пробелов и пустых элементов
+				bool is_valid = !value.empty() && value.front() != L',' && value.back() != L','
+					&& value.find(L",,") == std::wstring::npos && std::none_of(value.begin(), value.end(), [](wchar_t c) { return c == L'=' || c == L' '; });
+				if (!is_valid) {
+					er.append(L"Invalid value '").append(value).append(L"' for parameter '--").append(key).append(L"'.\n");
+					return false;
+				}
+			}
+			else if (key == L"session" || key == L"connect") {
+				if (value.empty() || !std::all_of(value.begin(), value.end(), [](wchar_t c) { return (c >= L'0' && c <= L'9') || c == L','; })) {
+					er.append(L"Invalid value '").append(value).append(L"' for parameter '--").append(key).append(L"', expected comma-separated numbers.\n");
+					return false;
+				}
+			}
+			else if (key == L"event" || key == L"offset") {
+				//N или (для --event) N-M, N <= M
+				auto is_number = [](const std::wstring& item) {
+					return !item.empty() && item.size() <= 18 && std::all_of(item.begin(), item.end(), [](wchar_t c) { return c >= L'0' && c <= L'9'; });
+				};
+				bool is_valid = !value.empty();
+				for (size_t begin = 0; is_valid && begin <= value.size();) {
+					size_t end = (std::min)(value.find(L',', begin), value.size());
+					const std::wstring item = value.substr(begin, end - begin);
+					const size_t dash = key == L"event" ? item.find(L'-') : std::wstring::npos;
+					is_valid = dash == std::wstring::npos ? is_number(item)
+						: is_number(item.substr(0, dash)) && is_number(item.substr(dash + 1))
+						&& std::stoull(item.substr(0, dash)) <= std::stoull(item.substr(dash + 1));
+					begin = end + 1;
+				}
+				if (!is_valid) {
+					er.append(L"Invalid value '").append(value).append(L"' for parameter '--").append(key).append(L"'.\n");
+					return false;
+				}
+			}
+			else if (key == L"drop") {
+				RetentionRule rule;
+				if (!RetentionRule::Parse(value, rule)) {
+					er.append(L"Invalid value '").append(value).append(L"' for parameter '--drop', expected NAME or NAME<N separated by commas.\n");
+					return false;
+				}
+			}
+			else if (key == L"filter-by") {
+				if (!(value == L"name" || value == L"mtime")) {
+					er.append(L"Invalid value '").append(value).append(L"' for parameter '--filter-by'.\n");
+					return false;
+				}
+			}
+			else if (key == L"include" || key == L"exclude" || key == L"include-active" || key == L"record-hash" || key == L"dry-run"
+				|| key == L"index" || key == L"stats" || key == L"summary") {
+			}
+			else if (key == L"cache") {
+				if (value.empty()) {
+					er.append(L"Invalid value '").append(value).append(L"' for parameter '--cache', expected a directory.\n");
+					return false;
+				}
+			}
+			else if (key == L"mem-budget") {
+				if (value.empty() || value.size() > 9 || !std::all_of(value.begin(), value.end(), [](wchar_t c) { return c >= L'0' && c <= L'9'; })) {
+					er.append(L"Invalid value '").append(value).append(L"' for parameter '--mem-budget'.\n");
+					return false;
+				}
+			}
+			else if (key == L"max-io" || key == L"max-cpu") {
+				if (value.empty() || value.size() > 9 || !std::all_of(value.begin(), value.end(), [](wchar_t c) { return c >= L'0' && c <= L'9'; })) {
+					er.append(L"Invalid value '").append(value).append(L"' for parameter '--").append(key).append(L"'.\n");
+					return false;
+				}
+			}
+			else if (key == L"nice") {
+				if (value.empty() || value.size() > 2 || !std::all_of(value.begin(), value.end(), [](wchar_t c) { return c >= L'0' && c <= L'9'; })
+					|| std::stoi(value) > 19) {
+					er.append(L"Invalid value '").append(value).append(L"' for parameter '--nice'.\n");
+					return false;
+				}
+			}
+			else if (key == L"ioprio") {
+				if (!(value == L"low" || value == L"idle")) {
+					er.append(L"Invalid value '").append(value).append(L"' for parameter '--ioprio'.\n");
+					return false;
+				}
+			}
+			else if (key == L"shard") {
+				size_t index = 0, count = 0;
+				if (!ShardPlan::Parse(value, index, count)) {
+					er.append(L"Invalid value '").append(value).append(L"' for parameter '--shard', expected i/N.\n");
+					return false;
+				}
+			}
+			else if (key == L"shard-split") {
+				if (value.empty() || value.size() > 9 || !std::all_of(value.begin(), value.end(), [](wchar_t c) { return c >= L'0' && c <= L'9'; })
+					|| std::stoull(value) == 0) {
+					er.append(L"Invalid value '").append(value).append(L"' for parameter '--shard-split'.\n");
+					return false;
+				}
+			}
+			else if (key == L"per-device") {
+				if (value.empty() || value.size() > 4 || !std::all_of(value.begin(), value.end(), [](wchar_t c) { return c >= L'0' && c <= L'9'; })
+					|| std::stoull(value) == 0) {
+					er.append(L"Invalid value '").append(value).append(L"' for parameter '--per-device'.\n");
+					return false;
+				}
+			}
+			else if (key == L"part-size") {
+				if (value.empty() || value.size() > 9 || !std::all_of(value.begin(), value.end(), [](wchar_t c) { return c >= L'0' && c <= L'9'; })
+					|| std::stoull(value) == 0) {
+					er.append(L"Invalid value '").append(value).append(L"' for parameter '--part-size'.\n");
+					return false;
+				}
+			}
+			else if (key == L"drop-cache") {
+				if (!(value == L"yes" || value == L"no")) {
+					er.append(L"Invalid value '").append(value).append(L"' for parameter '--drop-cache'.\n");
+					return false;
+				}
+			}
+			else if (key == L"compress") {
+				if (!(value == L"none" || value == L"gzip" || value == L"zstd")) {
+					er.append(L"Invalid value '").append(value).append(L"' for parameter '--compress'.\n");
+					return false;
+				}
 			}
 			else if (key == L"H" || key == L"help") {
 				key = L"help";
@@ -146,6 +515,23 @@ namespace soldy {
 		return false;
 	}
 
+	std::vector<std::wstring> ArgumentParser::getList(const std::wstring& key) const {
+		std::vector<std::wstring> list;
+		std::wstring value = get(key);
+		size_t begin = 0;
+		while (begin < value.size()) {
+			size_t end = value.find(L',', begin);
+			if (end == std::wstring::npos) {
+				end = value.size();
+			}
+			if (end > begin) {
+				list.push_back(value.substr(begin, end - begin));
+			}
+			begin = end + 1;
+		}
+		return list;
+	}
+
 	std::wstring ArgumentParser::get(const std::wstring& key, const std::wstring& defaultValue) const {
 		auto it = arguments_.find(key);
 		if (it != arguments_.end()) {
@@ -1,9 +1,12 @@
 ﻿#pragma once
 
+#include <cstdint>
 #include <string>
 #include <unordered_map>
+#include <vector>
 #include <clocale>
 #include <locale>
+#include <algorithm>
 
 namespace soldy {
 
@@ -12,6 +15,7 @@ namespace soldy {
 		std::unordered_map<std::wstring, std::wstring> arguments_;
 		bool parseArg(const std::wstring& arg, std::wstring& er);
 		std::wstring get(const std::wstring& key, const std::wstring& defaultValue = L"") const;
+		std::vector<std::wstring> getList(const std::wstring& key) const;
 	public:
 		ArgumentParser() = default;
 #ifdef _WIN32
@@ -22,6 +26,41 @@ namespace soldy {
 		std::wstring GetMode() const;
 		std::wstring GetPath() const;
 		std::wstring GetSimd() const;
+		std::wstring GetOut() const;
+		std::wstring GetHour() const;
+		std::wstring GetCompress() const;
+		std::wstring GetSince() const;
+		std::wstring GetUntil() const;
+		std::wstring GetFilterBy() const;
+		std::vector<std::wstring> GetInclude() const;
+		std::vector<std::wstring> GetExclude() const;
+		std::vector<std::wstring> GetSession() const;
+		std::vector<std::wstring> GetConnect() const;
+		std::wstring GetDrop() const;
+		std::wstring GetCache() const;
+		std::vector<std::wstring> GetEvent() const;
+		std::vector<std::wstring> GetOffset() const;
+		std::vector<std::wstring> GetColumns() const;
+		std::vector<std::wstring> GetName() const;
+		uint64_t GetMinDuration() const;
+		std::wstring GetFrom() const;
+		std::wstring GetTo() const;
+		bool IsIncludeActive() const;
+		bool IsRecordHash() const;
+		bool IsDryRun() const;
+		bool IsIndex() const;
+		bool IsStats() const;
+		bool IsSummary() const;
+		size_t GetMemoryBudget() const;
+		bool IsDropCache() const;
+		size_t GetMaxIo() const;
+		size_t GetMaxCpu() const;
+		size_t GetPerDevice() const;
+		int GetNice() const;
+		std::wstring GetIoPriority() const;
+		std::wstring GetShard() const;
+		size_t GetShardSplit() const;
+		size_t GetPartSize() const;
 		size_t GetChank() const;
 		int GetCountThread() const;
 		bool IsHelp() const;
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <deque>
+#include <mutex>
+#include <condition_variable>
+
+namespace soldy {
+
+	//Ограниченная очередь между потоками конвейера. Push блокируется при заполнении, Pop - при пустой очереди.
+	//После Close() Push возвращает false, Pop выдает оставшиеся элементы и затем false.
+	template <typename T>
+	class BlockingQueue {
+	private:
+		std::deque<T> items_;
+		std::mutex mutex_;
+		std::condition_variable not_empty_;
+		std::condition_variable not_full_;
+		size_t capacity_;
+		bool closed_ = false;
+	public:
+		explicit BlockingQueue(size_t capacity) : capacity_(capacity ? capacity : 1) {}
+		BlockingQueue(const BlockingQueue&) = delete;
+		BlockingQueue& operator=(const BlockingQueue&) = delete;
+
+		bool Push(T value) {
+			std::unique_lock<std::mutex> lock(mutex_);
+			not_full_.wait(lock, [this] { return closed_ || items_.size() < capacity_; });
+			if (closed_) {
+				return false;
+			}
+			items_.push_back(std::move(value));
+			not_empty_.notify_one();
+			return true;
+		}
+
+		bool Pop(T& value) {
+			std::unique_lock<std::mutex> lock(mutex_);
+			not_empty_.wait(lock, [this] { return closed_ || !items_.empty(); });
+			if (items_.empty()) {
+				return false;
+			}
+			value = std::move(items_.front());
+			items_.pop_front();
+			not_full_.notify_one();
+			return true;
+		}
+
+		void Close() {
+			std::lock_guard<std::mutex> lock(mutex_);
+			closed_ = true;
+			not_empty_.notify_all();
+			not_full_.notify_all();
+		}
+	};
+
+}
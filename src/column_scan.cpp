@@ -0,0 +1,198 @@
+#include "column_scan.h"
+
+#include <algorithm>
+#include <immintrin.h>
+#include "log_event.h"
+
+namespace soldy {
+
+	std::vector<uint64_t> ColumnScan::All(size_t count) {
+		std::vector<uint64_t> bits((count + 63) / 64, ~0ULL);
+		if (count % 64) {
+			bits.back() = (1ULL << (count % 64)) - 1;
+		}
+		return bits;
+	}
+
+	//Полные слова по 64 строки - ядром SIMD, хвост - по одной строке.
+	//Беззнаковое lo <= x < hi проверяется одним сравнением: x - lo < hi - lo
+	void ColumnScan::RangeU32(const uint32_t* column, size_t count, uint32_t lo, uint32_t hi, uint64_t* bits, SimdSupport::SimdLevel simd_level) {
+		const uint32_t width = hi > lo ? hi - lo : 0;
+		const size_t words = count / 64;
+		for (size_t w = 0; w < words; ++w) {
+			if (!bits[w]) {
+				continue;
+			}
+			if (simd_level == SimdSupport::SimdLevel::AVX512) {
+				bits[w] &= range_u32_512(column + w * 64, lo, width);
+			}
+			else if (simd_level == SimdSupport::SimdLevel::AVX2) {
+				bits[w] &= range_u32_256(column + w * 64, lo, width);
+			}
+			else {
+				for (uint64_t mask = bits[w]; mask; mask &= mask - 1) {
+					const size_t i = w * 64 + CTZ64(mask);
+					if (column[i] - lo >= width) {
+						bits[w] &= ~(1ULL << (i % 64));
+					}
+				}
+			}
+		}
+		for (size_t i = words * 64; i < count; ++i) {
+			if (column[i] - lo >= width) {
+				bits[i / 64] &= ~(1ULL << (i % 64));
+			}
+		}
+	}
+
+	void ColumnScan::AtLeastU64(const uint64_t* column, size_t count, uint64_t min, uint64_t* bits, SimdSupport::SimdLevel simd_level) {
+		const size_t words = count / 64;
+		for (size_t w = 0; w < words; ++w) {
+			if (!bits[w]) {
+				continue;
+			}
+			if (simd_level == SimdSupport::SimdLevel::AVX512) {
+				bits[w] &= at_least_u64_512(column + w * 64, min);
+			}
+			else if (simd_level == SimdSupport::SimdLevel::AVX2) {
+				bits[w] &= at_least_u64_256(column + w * 64, min);
+			}
+			else {
+				for (uint64_t mask = bits[w]; mask; mask &= mask - 1) {
+					const size_t i = w * 64 + CTZ64(mask);
+					if (column[i] < min) {
+						bits[w] &= ~(1ULL << (i % 64));
+					}
+				}
+			}
+		}
+		for (size_t i = words * 64; i < count; ++i) {
+			if (column[i] < min) {
+				bits[i / 64] &= ~(1ULL << (i % 64));
+			}
+		}
+	}
+
+	void ColumnScan::InU32(const uint32_t* column, size_t count, const std::vector<uint32_t>& values, uint64_t* bits, SimdSupport::SimdLevel simd_level) {
+		const size_t words = count / 64;
+		for (size_t w = 0; w < words; ++w) {
+			if (!bits[w]) {
+				continue;
+			}
+			if (simd_level == SimdSupport::SimdLevel::AVX512) {
+				bits[w] &= in_u32_512(column + w * 64, values);
+			}
+			else if (simd_level == SimdSupport::SimdLevel::AVX2) {
+				bits[w] &= in_u32_256(column + w * 64, values);
+			}
+			else {
+				for (uint64_t mask = bits[w]; mask; mask &= mask - 1) {
+					const size_t i = w * 64 + CTZ64(mask);
+					if (std::find(values.begin(), values.end(), column[i]) == values.end()) {
+						bits[w] &= ~(1ULL << (i % 64));
+					}
+				}
+			}
+		}
+		for (size_t i = words * 64; i < count; ++i) {
+			if (std::find(values.begin(), values.end(), column[i]) == values.end()) {
+				bits[i / 64] &= ~(1ULL << (i % 64));
+			}
+		}
+	}
+
+#ifdef __linux__
+	__attribute__((target("avx512f,avx512bw")))
+#endif
+	uint64_t ColumnScan::range_u32_512(const uint32_t* ch, uint32_t lo, uint32_t width) {
+		const __m512i lo_vec = _mm512_set1_epi32(static_cast<int>(lo));
+		const __m512i width_vec = _mm512_set1_epi32(static_cast<int>(width));
+		uint64_t mask = 0;
+		for (size_t i = 0; i < 4; ++i) {
+			__m512i block = _mm512_loadu_si512(reinterpret_cast<const __m512i*>(ch + i * 16));
+			__mmask16 in_range = _mm512_cmplt_epu32_mask(_mm512_sub_epi32(block, lo_vec), width_vec);
+			mask |= static_cast<uint64_t>(in_range) << (i * 16);
+		}
+		return mask;
+	}
+
+#ifdef __linux__
+	__attribute__((target("avx2")))
+#endif
+	uint64_t ColumnScan::range_u32_256(const uint32_t* ch, uint32_t lo, uint32_t width) {
+		//В AVX2 нет беззнакового сравнения: сдвиг обоих операндов на 0x80000000 и знаковое сравнение
+		const __m256i sign = _mm256_set1_epi32(static_cast<int>(0x80000000u));
+		const __m256i lo_vec = _mm256_set1_epi32(static_cast<int>(lo));
+		const __m256i width_vec = _mm256_xor_si256(_mm256_set1_epi32(static_cast<int>(width)), sign);
+		uint64_t mask = 0;
+		for (size_t i = 0; i < 8; ++i) {
+			__m256i block = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(ch + i * 8));
+			__m256i delta = _mm256_xor_si256(_mm256_sub_epi32(block, lo_vec), sign);
+			__m256i in_range = _mm256_cmpgt_epi32(width_vec, delta);
+			mask |= static_cast<uint64_t>(static_cast<uint32_t>(_mm256_movemask_ps(_mm256_castsi256_ps(in_range)))) << (i * 8);
+		}
+		return mask;
+	}
+
+#ifdef __linux__
+	__attribute__((target("avx512f,avx512bw")))
+#endif
+	uint64_t ColumnScan::at_least_u64_512(const uint64_t* ch, uint64_t min) {
+		const __m512i min_vec = _mm512_set1_epi64(static_cast<long long>(min));
+		uint64_t mask = 0;
+		for (size_t i = 0; i < 8; ++i) {
+			__m512i block = _mm512_loadu_si512(reinterpret_cast<const __m512i*>(ch + i * 8));
+			mask |= static_cast<uint64_t>(_mm512_cmpge_epu64_mask(block, min_vec)) << (i * 8);
+		}
+		return mask;
+	}
+
+#ifdef __linux__
+	__attribute__((target("avx2")))
+#endif
+	uint64_t ColumnScan::at_least_u64_256(const uint64_t* ch, uint64_t min) {
+		const __m256i sign = _mm256_set1_epi64x(static_cast<long long>(0x8000000000000000ULL));
+		const __m256i min_vec = _mm256_xor_si256(_mm256_set1_epi64x(static_cast<long long>(min)), sign);
+		uint64_t mask = 0;
+		for (size_t i = 0; i < 16; ++i) {
+			__m256i block = _mm256_xor_si256(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(ch + i * 4)), sign);
+			//x >= min - это не (min > x)
+			__m256i less = _mm256_cmpgt_epi64(min_vec, block);
+			mask |= static_cast<uint64_t>(~_mm256_movemask_pd(_mm256_castsi256_pd(less)) & 0xF) << (i * 4);
+		}
+		return mask;
+	}
+
+#ifdef __linux__
+	__attribute__((target("avx512f,avx512bw")))
+#endif
+	uint64_t ColumnScan::in_u32_512(const uint32_t* ch, const std::vector<uint32_t>& values) {
+		uint64_t mask = 0;
+		for (size_t i = 0; i < 4; ++i) {
+			__m512i block = _mm512_loadu_si512(reinterpret_cast<const __m512i*>(ch + i * 16));
+			__mmask16 found = 0;
+			for (uint32_t value : values) {
+				found |= _mm512_cmpeq_epi32_mask(block, _mm512_set1_epi32(static_cast<int>(value)));
+			}
+			mask |= static_cast<uint64_t>(found) << (i * 16);
+		}
+		return mask;
+	}
+
+#ifdef __linux__
+	__attribute__((target("avx2")))
+#endif
+	uint64_t ColumnScan::in_u32_256(const uint32_t* ch, const std::vector<uint32_t>& values) {
+		uint64_t mask = 0;
+		for (size_t i = 0; i < 8; ++i) {
+			__m256i block = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(ch + i * 8));
+			__m256i found = _mm256_setzero_si256();
+			for (uint32_t value : values) {
+				found = _mm256_or_si256(found, _mm256_cmpeq_epi32(block, _mm256_set1_epi32(static_cast<int>(value))));
+			}
+			mask |= static_cast<uint64_t>(static_cast<uint32_t>(_mm256_movemask_ps(_mm256_castsi256_ps(found)))) << (i * 8);
+		}
+		return mask;
+	}
+
+}
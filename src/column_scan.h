@@ -0,0 +1,32 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+#include "simd_support.h"
+
+namespace soldy {
+
+	//Предикаты над столбцами хранилища событий (EventStore). Результат - битовая маска строк: бит i слова i / 64.
+	//Каждый предикат сужает маску (AND), слова, в которых уже нет строк, пропускаются вместе с данными столбца,
+	//поэтому следующие предикаты читают только блоки с кандидатами.
+	class ColumnScan {
+	public:
+		//Маска из count строк, все выбраны
+		static std::vector<uint64_t> All(size_t count);
+		//lo <= column[i] < hi
+		static void RangeU32(const uint32_t* column, size_t count, uint32_t lo, uint32_t hi, uint64_t* bits, SimdSupport::SimdLevel simd_level);
+		//column[i] >= min
+		static void AtLeastU64(const uint64_t* column, size_t count, uint64_t min, uint64_t* bits, SimdSupport::SimdLevel simd_level);
+		//column[i] - одно из values
+		static void InU32(const uint32_t* column, size_t count, const std::vector<uint32_t>& values, uint64_t* bits, SimdSupport::SimdLevel simd_level);
+	private:
+		static uint64_t range_u32_512(const uint32_t* ch, uint32_t lo, uint32_t width);
+		static uint64_t range_u32_256(const uint32_t* ch, uint32_t lo, uint32_t width);
+		static uint64_t at_least_u64_512(const uint64_t* ch, uint64_t min);
+		static uint64_t at_least_u64_256(const uint64_t* ch, uint64_t min);
+		static uint64_t in_u32_512(const uint32_t* ch, const std::vector<uint32_t>& values);
+		static uint64_t in_u32_256(const uint32_t* ch, const std::vector<uint32_t>& values);
+	};
+
+}
@@ -0,0 +1,313 @@
+#include "compressed_file.h"
+
+#include <climits>
+#include <cerrno>
+#include <algorithm>
+
+namespace soldy {
+
+	static const size_t GZIP_BUFFER_SIZE = 1024 * 1024;
+	static const size_t FILE_BUFFER_SIZE = 1024 * 1024;
+
+	static std::FILE* open_file(const std::filesystem::path& file_path, bool write) {
+#ifdef _WIN32
+		return _wfopen(file_path.c_str(), write ? L"wb" : L"rb");
+#else
+		return std::fopen(file_path.c_str(), write ? "wb" : "rb");
+#endif
+	}
+
+#ifdef FLAT_LOG_ZLIB
+	static gzFile open_gzip(const std::filesystem::path& file_path, bool write) {
+#ifdef _WIN32
+		return gzopen_w(file_path.c_str(), write ? "wb6" : "rb");
+#else
+		return gzopen(file_path.c_str(), write ? "wb6" : "rb");
+#endif
+	}
+#endif
+
+	static bool ends_with(const std::wstring& str, const std::wstring& suffix) {
+		return str.size() >= suffix.size() && str.compare(str.size() - suffix.size(), suffix.size(), suffix) == 0;
+	}
+
+	Codec CodecFromPath(const std::filesystem::path& file_path) {
+		std::wstring name = file_path.filename().wstring();
+		if (ends_with(name, L".log.gz")) return Codec::Gzip;
+		if (ends_with(name, L".log.zst")) return Codec::Zstd;
+		return Codec::None;
+	}
+
+	std::wstring CodecExtension(Codec codec) {
+		if (codec == Codec::Gzip) return L".log.gz";
+		if (codec == Codec::Zstd) return L".log.zst";
+		return L".log";
+	}
+
+	bool IsCodecSupported([[maybe_unused]] Codec codec) {
+#ifndef FLAT_LOG_ZLIB
+		if (codec == Codec::Gzip) return false;
+#endif
+#ifndef FLAT_LOG_ZSTD
+		if (codec == Codec::Zstd) return false;
+#endif
+		return true;
+	}
+
+	bool CompressedReader::Open(const std::filesystem::path& file_path, Codec codec, std::error_code& ec) {
+		close();
+		codec_ = codec;
+		if (!IsCodecSupported(codec_)) {
+			ec = std::make_error_code(std::errc::not_supported);
+			return false;
+		}
+
+#ifdef FLAT_LOG_ZLIB
+		if (codec_ == Codec::Gzip) {
+			gz_ = open_gzip(file_path, false);
+			if (!gz_) {
+				ec = std::error_code(errno ? errno : EIO, std::generic_category());
+				return false;
+			}
+			gzbuffer(gz_, GZIP_BUFFER_SIZE);
+			return true;
+		}
+#endif
+
+		file_ = open_file(file_path, false);
+		if (!file_) {
+			ec = std::error_code(errno, std::generic_category());
+			return false;
+		}
+		std::setvbuf(file_, nullptr, _IOFBF, FILE_BUFFER_SIZE);
+
+#ifdef FLAT_LOG_ZSTD
+		if (codec_ == Codec::Zstd) {
+			dctx_ = ZSTD_createDCtx();
+			if (!dctx_) {
+				ec = std::make_error_code(std::errc::not_enough_memory);
+				return false;
+			}
+			in_.resize(ZSTD_DStreamInSize());
+			in_buffer_ = { in_.data(), 0, 0 };
+			frame_end_ = true;
+		}
+#endif
+		return true;
+	}
+
+	size_t CompressedReader::Read(char* data, size_t size, std::error_code& ec) {
+#ifdef FLAT_LOG_ZLIB
+		if (codec_ == Codec::Gzip) {
+			size_t read = 0;
+			while (read < size) {
+				int n = gzread(gz_, data + read, static_cast<unsigned>((std::min)(size - read, static_cast<size_t>(INT_MAX))));
+				if (n <= 0) {
+					int err = Z_OK;
+					gzerror(gz_, &err);
+					if (n < 0 || (err != Z_OK && err != Z_STREAM_END)) {
+						//Z_BUF_ERROR - файл обрезан
+						ec = std::make_error_code(std::errc::illegal_byte_sequence);
+						return 0;
+					}
+					break;
+				}
+				read += n;
+			}
+			return read;
+		}
+#endif
+
+#ifdef FLAT_LOG_ZSTD
+		if (codec_ == Codec::Zstd) {
+			ZSTD_outBuffer out = { data, size, 0 };
+			while (out.pos < out.size) {
+				if (in_buffer_.pos == in_buffer_.size) {
+					size_t n = std::fread(in_.data(), 1, in_.size(), file_);
+					if (!n) {
+						if (std::ferror(file_)) {
+							ec = std::error_code(EIO, std::generic_category());
+							return 0;
+						}
+						if (!frame_end_) {
+							ec = std::make_error_code(std::errc::illegal_byte_sequence);
+							return 0;
+						}
+						break;
+					}
+					in_buffer_ = { in_.data(), n, 0 };
+				}
+				size_t result = ZSTD_decompressStream(dctx_, &out, &in_buffer_);
+				if (ZSTD_isError(result)) {
+					ec = std::make_error_code(std::errc::illegal_byte_sequence);
+					return 0;
+				}
+				frame_end_ = (result == 0);
+			}
+			return out.pos;
+		}
+#endif
+
+		size_t n = std::fread(data, 1, size, file_);
+		if (n < size && std::ferror(file_)) {
+			ec = std::error_code(EIO, std::generic_category());
+			return 0;
+		}
+		return n;
+	}
+
+	void CompressedReader::close() {
+#ifdef FLAT_LOG_ZLIB
+		if (gz_) {
+			gzclose(gz_);
+			gz_ = nullptr;
+		}
+#endif
+#ifdef FLAT_LOG_ZSTD
+		if (dctx_) {
+			ZSTD_freeDCtx(dctx_);
+			dctx_ = nullptr;
+		}
+#endif
+		if (file_) {
+			std::fclose(file_);
+			file_ = nullptr;
+		}
+	}
+
+	bool CompressedWriter::Open(const std::filesystem::path& file_path, Codec codec, std::error_code& ec) {
+		close();
+		codec_ = codec;
+		if (!IsCodecSupported(codec_)) {
+			ec = std::make_error_code(std::errc::not_supported);
+			return false;
+		}
+
+#ifdef FLAT_LOG_ZLIB
+		if (codec_ == Codec::Gzip) {
+			gz_ = open_gzip(file_path, true);
+			if (!gz_) {
+				ec = std::error_code(errno ? errno : EIO, std::generic_category());
+				return false;
+			}
+			gzbuffer(gz_, GZIP_BUFFER_SIZE);
+			return true;
+		}
+#endif
+
+		file_ = open_file(file_path, true);
+		if (!file_) {
+			ec = std::error_code(errno, std::generic_category());
+			return false;
+		}
+		std::setvbuf(file_, nullptr, _IOFBF, FILE_BUFFER_SIZE);
+
+#ifdef FLAT_LOG_ZSTD
+		if (codec_ == Codec::Zstd) {
+			cctx_ = ZSTD_createCCtx();
+			if (!cctx_) {
+				ec = std::make_error_code(std::errc::not_enough_memory);
+				return false;
+			}
+			ZSTD_CCtx_setParameter(cctx_, ZSTD_c_compressionLevel, ZSTD_CLEVEL_DEFAULT);
+			out_.resize(ZSTD_CStreamOutSize());
+		}
+#endif
+		return true;
+	}
+
+	bool CompressedWriter::Write(const char* data, size_t size, std::error_code& ec) {
+#ifdef FLAT_LOG_ZLIB
+		if (codec_ == Codec::Gzip) {
+			while (size) {
+				unsigned part = static_cast<unsigned>((std::min)(size, static_cast<size_t>(INT_MAX)));
+				if (gzwrite(gz_, data, part) != static_cast<int>(part)) {
+					ec = std::error_code(EIO, std::generic_category());
+					return false;
+				}
+				data += part;
+				size -= part;
+			}
+			return true;
+		}
+#endif
+
+#ifdef FLAT_LOG_ZSTD
+		if (codec_ == Codec::Zstd) {
+			return compress(data, size, ZSTD_e_continue, ec);
+		}
+#endif
+
+		if (std::fwrite(data, 1, size, file_) != size) {
+			ec = std::error_code(EIO, std::generic_category());
+			return false;
+		}
+		return true;
+	}
+
+	bool CompressedWriter::Close(std::error_code& ec) {
+		bool result = true;
+#ifdef FLAT_LOG_ZLIB
+		if (gz_) {
+			result = gzclose(gz_) == Z_OK;
+			gz_ = nullptr;
+		}
+#endif
+#ifdef FLAT_LOG_ZSTD
+		if (cctx_) {
+			result = compress(nullptr, 0, ZSTD_e_end, ec);
+			ZSTD_freeCCtx(cctx_);
+			cctx_ = nullptr;
+		}
+#endif
+		if (file_) {
+			result = (std::fclose(file_) == 0) && result;
+			file_ = nullptr;
+		}
+		if (!result && !ec) {
+			ec = std::error_code(EIO, std::generic_category());
+		}
+		return result;
+	}
+
+#ifdef FLAT_LOG_ZSTD
+	bool CompressedWriter::compress(const char* data, size_t size, ZSTD_EndDirective mode, std::error_code& ec) {
+		ZSTD_inBuffer in = { data, size, 0 };
+		bool finished = false;
+		while (!finished) {
+			ZSTD_outBuffer out = { out_.data(), out_.size(), 0 };
+			size_t remaining = ZSTD_compressStream2(cctx_, &out, &in, mode);
+			if (ZSTD_isError(remaining)) {
+				ec = std::make_error_code(std::errc::illegal_byte_sequence);
+				return false;
+			}
+			if (std::fwrite(out_.data(), 1, out.pos, file_) != out.pos) {
+				ec = std::error_code(EIO, std::generic_category());
+				return false;
+			}
+			finished = (mode == ZSTD_e_end) ? remaining == 0 : in.pos == in.size;
+		}
+		return true;
+	}
+#endif
+
+	void CompressedWriter::close() {
+#ifdef FLAT_LOG_ZLIB
+		if (gz_) {
+			gzclose(gz_);
+			gz_ = nullptr;
+		}
+#endif
+#ifdef FLAT_LOG_ZSTD
+		if (cctx_) {
+			ZSTD_freeCCtx(cctx_);
+			cctx_ = nullptr;
+		}
+#endif
+		if (file_) {
+			std::fclose(file_);
+			file_ = nullptr;
+		}
+	}
+
+}
@@ -0,0 +1,82 @@
+#pragma once
+
+#include <filesystem>
+#include <vector>
+#include <cstdio>
+#include <string>
+
+#ifdef FLAT_LOG_ZLIB
+#include <zlib.h>
+#endif
+#ifdef FLAT_LOG_ZSTD
+#include <zstd.h>
+#endif
+
+namespace soldy {
+
+	enum class Codec {
+		None,
+		Gzip,
+		Zstd
+	};
+
+	//Определяет формат по расширению: *.log.gz, *.log.zst, остальное - несжатый журнал
+	Codec CodecFromPath(const std::filesystem::path& file_path);
+	//Расширение файла журнала для формата: .log, .log.gz, .log.zst
+	std::wstring CodecExtension(Codec codec);
+	//Поддерживается ли формат текущей сборкой
+	bool IsCodecSupported(Codec codec);
+
+	//Потоковое чтение файла журнала с распаковкой
+	class CompressedReader {
+	private:
+		Codec codec_ = Codec::None;
+		std::FILE* file_ = nullptr;
+#ifdef FLAT_LOG_ZLIB
+		gzFile gz_ = nullptr;
+#endif
+#ifdef FLAT_LOG_ZSTD
+		ZSTD_DCtx* dctx_ = nullptr;
+		std::vector<char> in_;
+		ZSTD_inBuffer in_buffer_{};
+		bool frame_end_ = true;
+#endif
+		void close();
+	public:
+		CompressedReader() = default;
+		~CompressedReader() { close(); }
+		CompressedReader(const CompressedReader&) = delete;
+		CompressedReader& operator=(const CompressedReader&) = delete;
+
+		bool Open(const std::filesystem::path& file_path, Codec codec, std::error_code& ec);
+		//Читает до size распакованных байт. 0 - конец файла (или ошибка, если установлен ec)
+		size_t Read(char* data, size_t size, std::error_code& ec);
+	};
+
+	//Потоковая запись файла журнала со сжатием
+	class CompressedWriter {
+	private:
+		Codec codec_ = Codec::None;
+		std::FILE* file_ = nullptr;
+#ifdef FLAT_LOG_ZLIB
+		gzFile gz_ = nullptr;
+#endif
+#ifdef FLAT_LOG_ZSTD
+		ZSTD_CCtx* cctx_ = nullptr;
+		std::vector<char> out_;
+		bool compress(const char* data, size_t size, ZSTD_EndDirective mode, std::error_code& ec);
+#endif
+		void close();
+	public:
+		CompressedWriter() = default;
+		~CompressedWriter() { close(); }
+		CompressedWriter(const CompressedWriter&) = delete;
+		CompressedWriter& operator=(const CompressedWriter&) = delete;
+
+		bool Open(const std::filesystem::path& file_path, Codec codec, std::error_code& ec);
+		bool Write(const char* data, size_t size, std::error_code& ec);
+		//Завершает поток сжатия и закрывает файл
+		bool Close(std::error_code& ec);
+	};
+
+}
@@ -0,0 +1,47 @@
+#include "device_scheduler.h"
+
+#include <fstream>
+#include <string>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/stat.h>
+#include <sys/sysmacros.h>
+#endif
+
+namespace soldy {
+
+#ifdef _WIN32
+	uint64_t DeviceOf(const std::filesystem::path& file) {
+		wchar_t volume[MAX_PATH];
+		DWORD serial = 0;
+		if (GetVolumePathNameW(file.c_str(), volume, MAX_PATH)) {
+			GetVolumeInformationW(volume, nullptr, 0, &serial, nullptr, nullptr, nullptr, 0);
+		}
+		return serial;
+	}
+#else
+	uint64_t DeviceOf(const std::filesystem::path& file) {
+		struct stat st;
+		if (::stat(file.c_str(), &st) != 0) {
+			return 0;
+		}
+
+		//Разделы одного диска - одно устройство. Сетевые и виртуальные файловые системы в /sys/dev/block не попадают
+		std::error_code ec;
+		const std::filesystem::path block = std::filesystem::path("/sys/dev/block")
+			/ (std::to_string(major(st.st_dev)) + ":" + std::to_string(minor(st.st_dev)));
+		if (std::filesystem::exists(block / "partition", ec)) {
+			const std::filesystem::path disk = std::filesystem::canonical(block, ec).parent_path();
+			unsigned int disk_major = 0, disk_minor = 0;
+			char colon = 0;
+			std::ifstream dev(disk / "dev");
+			if (!ec && dev >> disk_major >> colon >> disk_minor && colon == ':') {
+				return makedev(disk_major, disk_minor);
+			}
+		}
+		return st.st_dev;
+	}
+#endif
+
+}
@@ -0,0 +1,93 @@
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <condition_variable>
+#include <limits>
+#include <filesystem>
+
+namespace soldy {
+
+	//Устройство, на котором лежит файл: st_dev, раздел сводится к диску (Linux, /sys/dev/block).
+	//В Windows - серийный номер тома. Ошибка - устройство 0
+	uint64_t DeviceOf(const std::filesystem::path& file);
+
+	//Очередь файлов, сгруппированных по устройствам, с ограничением числа одновременно обрабатываемых файлов
+	//каждого устройства. Acquire выдает файл устройства, на котором сейчас меньше всего работы, поэтому потоки
+	//расходятся по дискам и пропускная способность растет с числом дисков, а не упирается в самый загруженный.
+	//Push/Close - со стороны обхода каталогов, Acquire/Release - со стороны обработчиков.
+	template <typename T>
+	class DeviceScheduler {
+	private:
+		struct Device {
+			std::deque<T> items;
+			size_t active = 0;
+		};
+		std::map<uint64_t, Device> devices_;
+		std::mutex mutex_;
+		std::condition_variable changed_;
+		size_t per_device_;
+		size_t queued_ = 0;
+		bool closed_ = false;
+	public:
+		//per_device == 0 - без ограничения, потоки только распределяются по устройствам
+		explicit DeviceScheduler(size_t per_device)
+			: per_device_(per_device ? per_device : (std::numeric_limits<size_t>::max)()) {}
+		DeviceScheduler(const DeviceScheduler&) = delete;
+		DeviceScheduler& operator=(const DeviceScheduler&) = delete;
+
+		void Push(uint64_t device, T value) {
+			std::lock_guard<std::mutex> lock(mutex_);
+			devices_[device].items.push_back(std::move(value));
+			++queued_;
+			changed_.notify_one();
+		}
+
+		void Close() {
+			std::lock_guard<std::mutex> lock(mutex_);
+			closed_ = true;
+			changed_.notify_all();
+		}
+
+		//Следующий элемент наименее загруженного устройства, у которого не исчерпан лимит.
+		//Ждет, пока такой элемент появится. false - очередь закрыта и пуста. После обработки - Release(device)
+		bool Acquire(T& value, uint64_t& device) {
+			std::unique_lock<std::mutex> lock(mutex_);
+			while (true) {
+				auto best = devices_.end();
+				for (auto it = devices_.begin(); it != devices_.end(); ++it) {
+					if (!it->second.items.empty() && it->second.active < per_device_
+						&& (best == devices_.end() || it->second.active < best->second.active)) {
+						best = it;
+					}
+				}
+				if (best != devices_.end()) {
+					value = std::move(best->second.items.front());
+					best->second.items.pop_front();
+					++best->second.active;
+					--queued_;
+					device = best->first;
+					return true;
+				}
+				if (closed_ && !queued_) {
+					return false;
+				}
+				changed_.wait(lock);
+			}
+		}
+
+		void Release(uint64_t device) {
+			std::lock_guard<std::mutex> lock(mutex_);
+			--devices_[device].active;
+			changed_.notify_all();
+		}
+
+		size_t Devices() {
+			std::lock_guard<std::mutex> lock(mutex_);
+			return devices_.size();
+		}
+	};
+
+}
@@ -0,0 +1,117 @@
+#include "event_counter.h"
+
+#include <algorithm>
+#include <cstring>
+#include "log_event.h"
+
+namespace soldy {
+
+	void EventCounter::Consume(const Slice& slice) {
+		if (!pending_.empty()) {
+			const size_t size_copy = (std::min)(HEADER_LIMIT - pending_.size(), slice.avail);
+			pending_.append(slice.data, size_copy);
+			std::string_view name;
+			uint64_t duration = 0;
+			Header header = LogEvent::ParseHeader(pending_.data(), pending_.size(), name, duration);
+			if (header != Header::Incomplete || pending_.size() == HEADER_LIMIT) {
+				add(header, name, duration);
+				pending_.clear();
+			}
+		}
+		const size_t words = (slice.size + 63) / 64;
+		for (size_t w = 0; w < words; ++w) {
+			for (uint64_t bits = slice.event_starts[w]; bits; bits &= bits - 1) {
+				const size_t pos = w * 64 + CTZ64(bits);
+				count(slice.data + pos, slice.size - pos, slice.avail - pos);
+			}
+		}
+	}
+
+	bool EventCounter::End(std::error_code&) {
+		if (!pending_.empty()) {
+			std::string_view name;
+			uint64_t duration = 0;
+			add(LogEvent::ParseHeader(pending_.data(), pending_.size(), name, duration), name, duration);
+			pending_.clear();
+		}
+		return true;
+	}
+
+	void EventCounter::Merge(const EventCounter& other) {
+		for (const auto& [name, item] : other.items_) {
+			Item& total = items_[name];
+			total.count += item.count;
+			total.duration += item.duration;
+		}
+		events_ += other.events_;
+		invalid_ += other.invalid_;
+	}
+
+	void EventCounter::Serialize(std::string& out) const {
+		auto put = [&out](uint64_t value) { out.append(reinterpret_cast<const char*>(&value), sizeof(value)); };
+		put(events_);
+		put(invalid_);
+		put(items_.size());
+		for (const auto& [name, item] : items_) {
+			put(name.size());
+			out.append(name);
+			put(item.count);
+			put(item.duration);
+		}
+	}
+
+	bool EventCounter::Deserialize(std::string_view data) {
+		auto get = [&data](uint64_t& value) {
+			if (data.size() < sizeof(value)) {
+				return false;
+			}
+			std::memcpy(&value, data.data(), sizeof(value));
+			data.remove_prefix(sizeof(value));
+			return true;
+		};
+		uint64_t count = 0;
+		if (!get(events_) || !get(invalid_) || !get(count)) {
+			return false;
+		}
+		items_.clear();
+		for (uint64_t i = 0; i < count; ++i) {
+			uint64_t size = 0;
+			if (!get(size) || data.size() < size) {
+				return false;
+			}
+			Item& item = items_[std::string(data.substr(0, size))];
+			data.remove_prefix(size);
+			if (!get(item.count) || !get(item.duration)) {
+				return false;
+			}
+		}
+		return data.empty();
+	}
+
+	void EventCounter::count(const char* ch, size_t size, size_t avail) {
+		std::string_view name;
+		uint64_t duration = 0;
+		Header header = LogEvent::ParseHeader(ch, (std::min)(avail, HEADER_LIMIT), name, duration);
+		//Следующая часть начинается с конца этой, продолжение заголовка добавится из нее
+		if (header == Header::Incomplete && avail < HEADER_LIMIT) {
+			pending_.assign(ch, size);
+			return;
+		}
+		add(header, name, duration);
+	}
+
+	void EventCounter::add(Header header, std::string_view name, uint64_t duration) {
+		++events_;
+		if (header != Header::Parsed) {
+			++invalid_;
+			return;
+		}
+		auto it = items_.find(name);
+		if (it == items_.end()) {
+			it = items_.emplace(std::string(name), Item()).first;
+		}
+		++it->second.count;
+		it->second.duration += duration;
+	}
+
+}
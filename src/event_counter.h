@@ -0,0 +1,44 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <map>
+#include <string>
+#include <string_view>
+#include "region_consumer.h"
+#include "log_event.h"
+
+namespace soldy {
+
+	//Количество и суммарная длительность событий по именам (MM:SS.ffffff-<длительность>,<событие>,...).
+	//Заголовок события, не уместившийся в доступные данные части, дочитывается из следующей.
+	class EventCounter : public RegionConsumer {
+	public:
+		struct Item {
+			uint64_t count = 0;
+			uint64_t duration = 0;
+		};
+		//Заголовок длиннее считается испорченным
+		static constexpr size_t HEADER_LIMIT = 128;
+
+		void Consume(const Slice& slice) override;
+		bool End(std::error_code& ec) override;
+		void Merge(const EventCounter& other);
+		//Двоичное представление для кэша результатов (--cache)
+		void Serialize(std::string& out) const;
+		bool Deserialize(std::string_view data);
+		const std::map<std::string, Item, std::less<>>& Items() const noexcept { return items_; }
+		uint64_t Events() const noexcept { return events_; }
+		//Начала событий без разбираемого заголовка
+		uint64_t Invalid() const noexcept { return invalid_; }
+	private:
+		using Header = LogEvent::Header;
+		std::map<std::string, Item, std::less<>> items_;
+		uint64_t events_ = 0;
+		uint64_t invalid_ = 0;
+		std::string pending_;
+		void count(const char* ch, size_t size, size_t avail);
+		void add(Header header, std::string_view name, uint64_t duration);
+	};
+
+}
@@ -0,0 +1,96 @@
+#include "event_index.h"
+
+#include <algorithm>
+#include <cstring>
+#include <limits>
+#include <fstream>
+#include "log_event.h"
+
+namespace soldy {
+
+	namespace {
+		const char MAGIC[8] = { 'F', 'L', 'A', 'T', 'I', 'D', 'X', '1' };
+	}
+
+	std::filesystem::path EventIndex::SidecarPath(const std::filesystem::path& file) {
+		std::filesystem::path sidecar = file;
+		sidecar += L".idx";
+		return sidecar;
+	}
+
+	bool EventIndex::Load(const std::filesystem::path& file, std::vector<uint64_t>& offsets, std::error_code& ec) {
+		uint64_t total = 0;
+		return LoadRange(file, 0, (std::numeric_limits<uint64_t>::max)(), offsets, total, ec);
+	}
+
+	bool EventIndex::LoadRange(const std::filesystem::path& file, uint64_t first, uint64_t count, std::vector<uint64_t>& offsets,
+		uint64_t& total, std::error_code& ec) {
+		const uint64_t file_size = std::filesystem::file_size(file, ec);
+		if (ec) {
+			return false;
+		}
+		std::ifstream stream(SidecarPath(file), std::ios::binary);
+		if (!stream) {
+			ec = std::make_error_code(std::errc::no_such_file_or_directory);
+			return false;
+		}
+		char magic[sizeof(MAGIC)];
+		uint64_t index_file_size = 0;
+		stream.read(magic, sizeof(magic));
+		stream.read(reinterpret_cast<char*>(&index_file_size), sizeof(index_file_size));
+		stream.read(reinterpret_cast<char*>(&total), sizeof(total));
+		if (!stream || std::memcmp(magic, MAGIC, sizeof(MAGIC)) != 0 || total > file_size) {
+			ec = std::make_error_code(std::errc::invalid_argument);
+			return false;
+		}
+		//Файл дописан после построения индекса
+		if (index_file_size != file_size) {
+			ec = std::make_error_code(std::errc::invalid_argument);
+			return false;
+		}
+		first = (std::min)(first, total);
+		count = (std::min)(count, total - first);
+		offsets.resize(count);
+		stream.seekg(static_cast<std::streamoff>(sizeof(MAGIC) + 2 * sizeof(uint64_t) + first * sizeof(uint64_t)));
+		stream.read(reinterpret_cast<char*>(offsets.data()), count * sizeof(uint64_t));
+		if (!stream) {
+			ec = std::make_error_code(std::errc::invalid_argument);
+			return false;
+		}
+		return true;
+	}
+
+	void EventIndex::Begin(const std::filesystem::path& file, size_t file_size) {
+		file_ = file;
+		file_size_ = file_size;
+		offsets_.clear();
+	}
+
+	void EventIndex::Consume(const Slice& slice) {
+		const size_t words = (slice.size + 63) / 64;
+		for (size_t w = 0; w < words; ++w) {
+			for (uint64_t bits = slice.event_starts[w]; bits; bits &= bits - 1) {
+				offsets_.push_back(slice.offset + w * 64 + CTZ64(bits));
+			}
+		}
+	}
+
+	bool EventIndex::End(std::error_code& ec) {
+		std::ofstream stream(SidecarPath(file_), std::ios::binary | std::ios::trunc);
+		if (!stream) {
+			ec = std::make_error_code(std::errc::permission_denied);
+			return false;
+		}
+		const uint64_t count = offsets_.size();
+		stream.write(MAGIC, sizeof(MAGIC));
+		stream.write(reinterpret_cast<const char*>(&file_size_), sizeof(file_size_));
+		stream.write(reinterpret_cast<const char*>(&count), sizeof(count));
+		stream.write(reinterpret_cast<const char*>(offsets_.data()), count * sizeof(uint64_t));
+		if (!stream.flush()) {
+			ec = std::make_error_code(std::errc::io_error);
+			return false;
+		}
+		return true;
+	}
+
+}
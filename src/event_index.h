@@ -0,0 +1,34 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <filesystem>
+#include <vector>
+#include <system_error>
+#include "region_consumer.h"
+
+namespace soldy {
+
+	//Индекс смещений начала событий журнала: <файл>.idx. Строится за тот же проход, что и преобразование.
+	//Преобразование не меняет размер файла, поэтому индекс верен и для flat, и для исходного представления.
+	//Формат: "FLATIDX1", размер файла (uint64), количество событий (uint64), смещения (uint64), little-endian.
+	class EventIndex : public RegionConsumer {
+	public:
+		static std::filesystem::path SidecarPath(const std::filesystem::path& file);
+		//Загружает индекс, если он построен для файла текущего размера
+		static bool Load(const std::filesystem::path& file, std::vector<uint64_t>& offsets, std::error_code& ec);
+		//Загружает только смещения событий [first, first + count) (меньше в конце индекса), total - всего событий
+		static bool LoadRange(const std::filesystem::path& file, uint64_t first, uint64_t count, std::vector<uint64_t>& offsets,
+			uint64_t& total, std::error_code& ec);
+
+		void Begin(const std::filesystem::path& file, size_t file_size) override;
+		void Consume(const Slice& slice) override;
+		bool End(std::error_code& ec) override;
+		size_t Count() const noexcept { return offsets_.size(); }
+	private:
+		std::filesystem::path file_;
+		uint64_t file_size_ = 0;
+		std::vector<uint64_t> offsets_;
+	};
+
+}
@@ -0,0 +1,99 @@
+#include "event_reader.h"
+
+namespace soldy {
+
+	EventReader::EventReader(SimdSupport::SimdLevel simd_level, size_t window_size)
+		: simd_level_(simd_level), window_size_(window_size) {
+	}
+
+	bool EventReader::Open(const std::filesystem::path& file_path, std::error_code& ec) {
+		event_ = nullptr;
+		event_size_ = 0;
+		window_offset_ = window_end_ = 0;
+		if (!mapped_file_.OpenSequential(file_path, ec, MappedFile::Access::ReadOnly)) {
+			return false;
+		}
+
+		const size_t file_size = mapped_file_.FileSize();
+		if (!file_size) {
+			pos_ = 0;
+			return true;
+		}
+		if (!map_window(0, (std::min)(window_size_, file_size), ec)) {
+			return false;
+		}
+
+		pos_ = LogEvent::BomSize(at(0), window_end_);
+		//Файл может начинаться с хвоста события (например, после обрезки), пропускаем его. Файл только из BOM - без событий
+		if (pos_ < file_size && (pos_ + LogEvent::TIMESTAMP_SIZE > file_size || !LogEvent::IsNewEvent(at(pos_)))) {
+			size_t end = 0;
+			if (!find_event_end(end, ec)) {
+				return false;
+			}
+			pos_ = end;
+		}
+		return true;
+	}
+
+	bool EventReader::Next(std::error_code& ec) {
+		event_ = nullptr;
+		event_size_ = 0;
+		if (pos_ >= mapped_file_.FileSize()) {
+			return false;
+		}
+
+		size_t end = 0;
+		if (!find_event_end(end, ec)) {
+			return false;
+		}
+
+		event_offset_ = pos_;
+		event_size_ = end - pos_;
+		event_ = at(pos_);
+		pos_ = end;
+		return true;
+	}
+
+	bool EventReader::find_event_end(size_t& end, std::error_code& ec) {
+		const size_t file_size = mapped_file_.FileSize();
+		size_t scan = pos_ + 1;
+
+		if (pos_ < window_offset_ || pos_ >= window_end_) {
+			if (!map_window(pos_, (std::min)(window_size_, file_size - pos_), ec)) {
+				return false;
+			}
+		}
+
+		while (true) {
+			const char* found = scan < window_end_ ? LogEvent::FindNextEvent(at(scan), at(window_end_), simd_level_) : nullptr;
+			if (found) {
+				end = window_offset_ + (found - at(window_offset_));
+				return true;
+			}
+			if (window_end_ == file_size) {
+				end = file_size;
+				return true;
+			}
+
+			//Событие не поместилось в окно: переотображаем окно с начала события и увеличиваем его.
+			//Переводы строк ближе TIMESTAMP_SIZE к концу окна не проверялись, с них и продолжаем.
+			scan = (std::max)(scan, window_end_ - (std::min)(window_end_, LogEvent::TIMESTAMP_SIZE));
+			size_t size = (std::max)(window_size_, 2 * (window_end_ - pos_));
+			if (!map_window(pos_, (std::min)(size, file_size - pos_), ec)) {
+				return false;
+			}
+		}
+	}
+
+	bool EventReader::map_window(size_t offset, size_t size, std::error_code& ec) {
+		if (!mapped_file_.MapRegion(offset, size, ec)) {
+			window_offset_ = window_end_ = 0;
+			return false;
+		}
+		window_offset_ = offset;
+		window_end_ = offset + size;
+		mapped_file_.Prefetch(window_end_, window_size_);
+		return true;
+	}
+
+}
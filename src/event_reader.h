@@ -0,0 +1,44 @@
+#pragma once
+
+#include <filesystem>
+#include <string>
+#include "mapped_file.h"
+#include "simd_support.h"
+#include "log_event.h"
+
+namespace soldy {
+
+	//Последовательное чтение событий файла через скользящее окно проекции (файл целиком в память не отображается).
+	//Указатель Data() действителен до следующего вызова Next().
+	class EventReader {
+	private:
+		MappedFile mapped_file_;
+		SimdSupport::SimdLevel simd_level_;
+		size_t window_size_;
+		size_t window_offset_ = 0;
+		size_t window_end_ = 0;
+		size_t pos_ = 0;
+		size_t event_offset_ = 0;
+		size_t event_size_ = 0;
+		const char* event_ = nullptr;
+		bool map_window(size_t offset, size_t size, std::error_code& ec);
+		const char* at(size_t offset) const { return static_cast<const char*>(mapped_file_.Data()) + (offset - window_offset_); }
+		bool find_event_end(size_t& end, std::error_code& ec);
+	public:
+		static constexpr size_t DEFAULT_WINDOW_SIZE = 16 * 1024 * 1024;
+
+		explicit EventReader(SimdSupport::SimdLevel simd_level, size_t window_size = DEFAULT_WINDOW_SIZE);
+		EventReader(const EventReader&) = delete;
+		EventReader& operator=(const EventReader&) = delete;
+
+		bool Open(const std::filesystem::path& file_path, std::error_code& ec);
+		//Переходит к следующему событию. false - событий больше нет или ошибка (ec)
+		bool Next(std::error_code& ec);
+		const char* Data() const noexcept { return event_; }
+		size_t Size() const noexcept { return event_size_; }
+		size_t Offset() const noexcept { return event_offset_; }
+		uint64_t Timestamp() const noexcept { return LogEvent::Timestamp(event_); }
+		size_t FileSize() const noexcept { return mapped_file_.FileSize(); }
+	};
+
+}
@@ -0,0 +1,182 @@
+#include "event_store.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include "column_scan.h"
+#include "log_event.h"
+
+namespace soldy {
+
+	namespace {
+		const char MAGIC[8] = { 'F', 'L', 'A', 'T', 'S', 'T', 'O', '1' };
+		//Время от начала часа не больше 59:59.999999
+		const uint64_t HOUR = 3600ULL * 1000000ULL;
+
+		bool read_string(std::ifstream& stream, std::string& value) {
+			uint32_t size = 0;
+			stream.read(reinterpret_cast<char*>(&size), sizeof(size));
+			if (!stream || size > 64 * 1024 * 1024) {
+				return false;
+			}
+			value.resize(size);
+			stream.read(value.data(), size);
+			return static_cast<bool>(stream);
+		}
+	}
+
+	std::filesystem::path EventStore::StorePath(const std::filesystem::path& file) {
+		std::filesystem::path store = file;
+		store += L".store";
+		return store;
+	}
+
+	//Имена свойств (t:connectID) не годятся для имен файлов в Windows, поэтому файлы столбцов нумеруются
+	std::filesystem::path EventStore::ColumnPath(const std::filesystem::path& dir, size_t column) {
+		return dir / (L"c" + std::to_wstring(column) + L".col");
+	}
+
+	const std::vector<std::string>& EventStore::DefaultProperties() {
+		static const std::vector<std::string> properties = { "process", "p:processName", "Usr", "SessionID", "t:connectID" };
+		return properties;
+	}
+
+	EventStore::EventStore(SimdSupport::SimdLevel simd_level) : simd_level_(simd_level) {
+	}
+
+	bool EventStore::Open(const std::filesystem::path& file, std::error_code& ec) {
+		columns_.clear();
+		const uint64_t file_size = std::filesystem::file_size(file, ec);
+		if (ec) {
+			return false;
+		}
+		const std::filesystem::path dir = StorePath(file);
+		uint64_t source_size = 0;
+		if (!read_meta(dir, source_size, ec)) {
+			return false;
+		}
+		//Файл дописан или изменен после построения хранилища
+		if (source_size != file_size) {
+			ec = std::make_error_code(std::errc::invalid_argument);
+			return false;
+		}
+		for (size_t column = 0; column < PROPERTIES + properties_.size(); ++column) {
+			const size_t width = (column == DURATION || column == OFFSET) ? sizeof(uint64_t) : sizeof(uint32_t);
+			MappedFile& mapped_file = columns_.emplace_back();
+			if (!mapped_file.OpenSequential(ColumnPath(dir, column), ec, MappedFile::Access::ReadOnly)) {
+				return false;
+			}
+			if (mapped_file.FileSize() != events_ * width) {
+				ec = std::make_error_code(std::errc::invalid_argument);
+				return false;
+			}
+			//Пустой файл не отображается, столбец без событий не читается
+			if (events_ && !mapped_file.MapRegion(0, mapped_file.FileSize(), ec)) {
+				return false;
+			}
+		}
+		return true;
+	}
+
+	bool EventStore::read_meta(const std::filesystem::path& dir, uint64_t& source_size, std::error_code& ec) {
+		std::ifstream stream(dir / L"meta", std::ios::binary);
+		if (!stream) {
+			ec = std::make_error_code(std::errc::no_such_file_or_directory);
+			return false;
+		}
+		char magic[sizeof(MAGIC)];
+		uint32_t count = 0;
+		stream.read(magic, sizeof(magic));
+		stream.read(reinterpret_cast<char*>(&source_size), sizeof(source_size));
+		stream.read(reinterpret_cast<char*>(&events_), sizeof(events_));
+		stream.read(reinterpret_cast<char*>(&hour_time_), sizeof(hour_time_));
+		stream.read(reinterpret_cast<char*>(&count), sizeof(count));
+		if (!stream || std::memcmp(magic, MAGIC, sizeof(MAGIC)) != 0 || events_ > source_size || count > 1024) {
+			ec = std::make_error_code(std::errc::invalid_argument);
+			return false;
+		}
+		properties_.resize(count);
+		for (auto& property : properties_) {
+			if (!read_string(stream, property)) {
+				ec = std::make_error_code(std::errc::invalid_argument);
+				return false;
+			}
+		}
+		dictionaries_.assign(count + 1, {});
+		for (auto& dictionary : dictionaries_) {
+			uint32_t size = 0;
+			stream.read(reinterpret_cast<char*>(&size), sizeof(size));
+			if (!stream || size == 0 || size > events_ + 1) {
+				ec = std::make_error_code(std::errc::invalid_argument);
+				return false;
+			}
+			dictionary.resize(size);
+			for (auto& value : dictionary) {
+				if (!read_string(stream, value)) {
+					ec = std::make_error_code(std::errc::invalid_argument);
+					return false;
+				}
+			}
+		}
+		return true;
+	}
+
+	bool EventStore::Select(const Query& query, std::vector<uint64_t>& rows, std::error_code& ec) const {
+		rows.clear();
+		//Номера искомых значений в словарях: значения нет в словаре - нет и подходящих событий
+		std::vector<uint32_t> names;
+		ids_of(dictionaries_[0], query.names, names);
+		std::vector<std::pair<size_t, std::vector<uint32_t>>> properties;
+		for (const auto& [property, values] : query.properties) {
+			const auto it = std::find(properties_.begin(), properties_.end(), property);
+			if (it == properties_.end()) {
+				ec = std::make_error_code(std::errc::invalid_argument);
+				return false;
+			}
+			const size_t index = static_cast<size_t>(it - properties_.begin());
+			properties.emplace_back(index, std::vector<uint32_t>());
+			ids_of(dictionaries_[index + 1], values, properties.back().second);
+			if (properties.back().second.empty()) {
+				return true;
+			}
+		}
+		const bool is_time_limited = query.from > hour_time_ || query.to < hour_time_ + HOUR;
+		if (!events_ || (!query.names.empty() && names.empty()) || query.to <= hour_time_ || query.from >= hour_time_ + HOUR) {
+			return true;
+		}
+
+		//Сначала столбцы по 4 байта, столбец длительностей (8 байтов) - для оставшихся блоков
+		const size_t count = static_cast<size_t>(events_);
+		std::vector<uint64_t> bits = ColumnScan::All(count);
+		if (!names.empty()) {
+			ColumnScan::InU32(&at<uint32_t>(EVENT, 0), count, names, bits.data(), simd_level_);
+		}
+		if (is_time_limited) {
+			const uint32_t lo = static_cast<uint32_t>(query.from > hour_time_ ? query.from - hour_time_ : 0);
+			const uint32_t hi = static_cast<uint32_t>((std::min)(query.to - hour_time_, HOUR));
+			ColumnScan::RangeU32(&at<uint32_t>(TIME, 0), count, lo, hi, bits.data(), simd_level_);
+		}
+		for (const auto& [index, ids] : properties) {
+			ColumnScan::InU32(&at<uint32_t>(PROPERTIES + index, 0), count, ids, bits.data(), simd_level_);
+		}
+		if (query.min_duration) {
+			ColumnScan::AtLeastU64(&at<uint64_t>(DURATION, 0), count, query.min_duration, bits.data(), simd_level_);
+		}
+		for (size_t w = 0; w < bits.size(); ++w) {
+			for (uint64_t mask = bits[w]; mask; mask &= mask - 1) {
+				rows.push_back(w * 64 + CTZ64(mask));
+			}
+		}
+		return true;
+	}
+
+	void EventStore::ids_of(const std::vector<std::string>& dictionary, const std::vector<std::string>& values, std::vector<uint32_t>& ids) {
+		for (const auto& value : values) {
+			const auto it = std::find(dictionary.begin() + 1, dictionary.end(), value);
+			if (it != dictionary.end()) {
+				ids.push_back(static_cast<uint32_t>(it - dictionary.begin()));
+			}
+		}
+	}
+
+}
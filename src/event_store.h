@@ -0,0 +1,86 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <deque>
+#include <filesystem>
+#include <limits>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+#include <system_error>
+#include "mapped_file.h"
+#include "simd_support.h"
+
+namespace soldy {
+
+	//Столбцовое хранилище событий flat-журнала: каталог <файл>.store, строится режимом build-store (StoreBuilder).
+	//Каждый столбец - массив значений в своем файле (c<номер>.col), отображается в память целиком, запрос проверяет
+	//условия над столбцами ядрами ColumnScan и читает по несколько байтов на событие вместо разбора текста.
+	//Столбцы: время от начала часа (uint32, мкс), длительность (uint64), номер имени события (uint32), смещение
+	//события в файле (uint64), далее по столбцу uint32 на каждое свойство (номер значения в словаре, 0 - свойства нет).
+	//Файл meta: "FLATSTO1", размер исходного файла, количество событий, начало часа (uint64), свойства и словари
+	//(uint32 количество строк, далее uint32 длина и байты строки), little-endian.
+	class EventStore {
+	public:
+		enum Column : size_t {
+			TIME,
+			DURATION,
+			EVENT,
+			OFFSET,
+			//Первое свойство
+			PROPERTIES
+		};
+		static constexpr uint64_t NO_TIME = (std::numeric_limits<uint64_t>::max)();
+
+		//Условия отбора, должны выполняться все. Пустой список - условия нет
+		struct Query {
+			std::vector<std::string> names;
+			uint64_t min_duration = 0;
+			//[from, to) в микросекундах: час YYMMDDHH * 3600 * 10^6 + время от начала часа
+			uint64_t from = 0;
+			uint64_t to = NO_TIME;
+			//Свойство и допустимые значения
+			std::vector<std::pair<std::string, std::vector<std::string>>> properties;
+		};
+
+		static std::filesystem::path StorePath(const std::filesystem::path& file);
+		static std::filesystem::path ColumnPath(const std::filesystem::path& dir, size_t column);
+		//Свойства по умолчанию (--columns). Свойство process хранится всегда
+		static const std::vector<std::string>& DefaultProperties();
+
+		explicit EventStore(SimdSupport::SimdLevel simd_level);
+		EventStore(const EventStore&) = delete;
+		EventStore& operator=(const EventStore&) = delete;
+
+		//Открывает хранилище, построенное для файла текущего размера
+		bool Open(const std::filesystem::path& file, std::error_code& ec);
+		//Номера подходящих событий по порядку. Свойства нет в хранилище - ошибка
+		bool Select(const Query& query, std::vector<uint64_t>& rows, std::error_code& ec) const;
+
+		uint64_t Events() const noexcept { return events_; }
+		uint64_t HourTime() const noexcept { return hour_time_; }
+		const std::vector<std::string>& Properties() const noexcept { return properties_; }
+		uint64_t Time(uint64_t row) const noexcept { return hour_time_ + at<uint32_t>(TIME, row); }
+		uint64_t Duration(uint64_t row) const noexcept { return at<uint64_t>(DURATION, row); }
+		const std::string& Event(uint64_t row) const noexcept { return dictionaries_[0][at<uint32_t>(EVENT, row)]; }
+		uint64_t Offset(uint64_t row) const noexcept { return at<uint64_t>(OFFSET, row); }
+		const std::string& Property(size_t property, uint64_t row) const noexcept {
+			return dictionaries_[property + 1][at<uint32_t>(PROPERTIES + property, row)];
+		}
+	private:
+		SimdSupport::SimdLevel simd_level_;
+		uint64_t events_ = 0;
+		uint64_t hour_time_ = 0;
+		std::vector<std::string> properties_;
+		//0 - имена событий, далее словари свойств
+		std::vector<std::vector<std::string>> dictionaries_;
+		std::deque<MappedFile> columns_;
+		bool read_meta(const std::filesystem::path& dir, uint64_t& source_size, std::error_code& ec);
+		static void ids_of(const std::vector<std::string>& dictionary, const std::vector<std::string>& values, std::vector<uint32_t>& ids);
+		template<typename T>
+		const T& at(size_t column, uint64_t row) const noexcept { return static_cast<const T*>(columns_[column].Data())[row]; }
+	};
+
+}
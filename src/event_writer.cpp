@@ -0,0 +1,111 @@
+#include "event_writer.h"
+
+#include <cstring>
+
+namespace soldy {
+
+	EventWriter::EventWriter(size_t buffer_size) : buffer_(buffer_size) {
+	}
+
+	EventWriter::~EventWriter() {
+		std::error_code ec;
+		Close(ec);
+	}
+
+	bool EventWriter::Open(const std::filesystem::path& file_path, std::error_code& ec) {
+		out_.open(file_path, std::ios::binary | std::ios::trunc);
+		if (!out_) {
+			ec = std::make_error_code(std::errc::io_error);
+			return false;
+		}
+		buffer_pos_ = 0;
+		size_ = 0;
+		static const char bom[] = { '\xEF', '\xBB', '\xBF' };
+		put(bom, sizeof(bom));
+		return true;
+	}
+
+	bool EventWriter::Write(const char* data, size_t size, std::error_code& ec) {
+		if (buffer_pos_ + size > buffer_.size() && !flush(ec)) {
+			return false;
+		}
+		if (size > buffer_.size()) {
+			out_.write(data, size);
+			size_ += size;
+			if (!out_) {
+				ec = std::make_error_code(std::errc::io_error);
+				return false;
+			}
+			return true;
+		}
+		put(data, size);
+		return true;
+	}
+
+	bool EventWriter::WriteFlat(const char* data, size_t size, std::error_code& ec) {
+		if (!size) {
+			return true;
+		}
+		//Завершающий перевод строки события сохраняем, остальные заменяем
+		const bool has_lf = data[size - 1] == LogEvent::LF;
+		const char* end = data + size - (has_lf ? 1 : 0);
+		const char* cur = data;
+		while (cur < end) {
+			const char* lf = static_cast<const char*>(std::memchr(cur, LogEvent::LF, end - cur));
+			const char* seg_end = lf ? lf : end;
+			if (lf) {
+				size_t seg = seg_end - cur;
+				bool has_cr = seg && *(seg_end - 1) == LogEvent::CR;
+				if (!Write(cur, seg - (has_cr ? 1 : 0), ec)) {
+					return false;
+				}
+				static const char change_crlf[] = { LogEvent::CHANGE_CR, LogEvent::CHANGE_LF };
+				if (!Write(has_cr ? change_crlf : change_crlf + 1, has_cr ? 2 : 1, ec)) {
+					return false;
+				}
+				cur = lf + 1;
+			}
+			else {
+				if (!Write(cur, seg_end - cur, ec)) {
+					return false;
+				}
+				cur = seg_end;
+			}
+		}
+		//Последнее событие оборванного файла может не иметь перевода строки
+		static const char crlf[] = { LogEvent::CR, LogEvent::LF };
+		return has_lf ? Write(data + size - 1, 1, ec) : Write(crlf, sizeof(crlf), ec);
+	}
+
+	bool EventWriter::Close(std::error_code& ec) {
+		if (!out_.is_open()) {
+			return true;
+		}
+		bool result = flush(ec);
+		out_.close();
+		if (result && out_.fail()) {
+			ec = std::make_error_code(std::errc::io_error);
+			result = false;
+		}
+		return result;
+	}
+
+	bool EventWriter::flush(std::error_code& ec) {
+		if (buffer_pos_) {
+			out_.write(buffer_.data(), buffer_pos_);
+			buffer_pos_ = 0;
+			if (!out_) {
+				ec = std::make_error_code(std::errc::io_error);
+				return false;
+			}
+		}
+		return true;
+	}
+
+	void EventWriter::put(const char* data, size_t size) {
+		std::memcpy(buffer_.data() + buffer_pos_, data, size);
+		buffer_pos_ += size;
+		size_ += size;
+	}
+
+}
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <filesystem>
+#include <fstream>
+#include <vector>
+#include <string>
+#include "log_event.h"
+
+namespace soldy {
+
+	//Буферизованная запись событий в файл журнала в "плоском" виде: переводы строк внутри события
+	//заменяются служебными символами, каждое событие завершается переводом строки.
+	class EventWriter {
+	private:
+		std::ofstream out_;
+		std::vector<char> buffer_;
+		size_t buffer_pos_ = 0;
+		size_t size_ = 0;
+		bool flush(std::error_code& ec);
+		void put(const char* data, size_t size);
+	public:
+		static constexpr size_t DEFAULT_BUFFER_SIZE = 4 * 1024 * 1024;
+
+		explicit EventWriter(size_t buffer_size = DEFAULT_BUFFER_SIZE);
+		~EventWriter();
+		EventWriter(const EventWriter&) = delete;
+		EventWriter& operator=(const EventWriter&) = delete;
+
+		bool Open(const std::filesystem::path& file_path, std::error_code& ec);
+		//Записывает событие как есть
+		bool Write(const char* data, size_t size, std::error_code& ec);
+		//Записывает событие, заменяя переводы строк внутри события на CHANGE_LF/CHANGE_CR
+		bool WriteFlat(const char* data, size_t size, std::error_code& ec);
+		bool Close(std::error_code& ec);
+		size_t Size() const noexcept { return size_; }
+	};
+
+}
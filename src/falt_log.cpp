@@ -7,52 +7,205 @@ namespace soldy {
 	}
 
 	bool FlatLog::Open(std::error_code& ec) {
-		return mapped_file_.OpenSequential(file_path_, ec);
+		return mapped_file_.OpenSequential(file_path_, ec, is_dry_run_ ? MappedFile::Access::ReadOnly : MappedFile::Access::ReadWrite);
 	}
 
 	bool FlatLog::ProcessData(Mode mode, size_t chank_size, std::error_code& ec) {
+		return ProcessRange(mode, 0, mapped_file_.FileSize(), chank_size, ec);
+	}
+
+	bool FlatLog::ProcessRange(Mode mode, size_t begin, size_t end, size_t chank_size, std::error_code& ec) {
 		
 		const size_t file_size = mapped_file_.FileSize();
-		const size_t block_size = (simd_level_ == SimdSupport::SimdLevel::None) ? 12 : simd_support_.BlockSize(simd_level_);
-		const size_t delta_offset = chank_size - block_size;
+		const size_t block_size = this->block_size();
+		end = (std::min)(end, file_size);
+		if (begin >= end) {
+			return true;
+		}
+		for (auto consumer : consumers_) {
+			consumer->Begin(file_path_, file_size);
+		}
+		carry_event_start_ = false;
+		range_begin_ = begin;
 
 		//Т.к. для анализа нужна информация из следующго блока, то обрабатываем не все блоки в выделенном MapRegion, а на один меньше
-		//Начало следующего MapRegion сдвигаем на размер block_size от конца предыдушего
+		//Начало следующего MapRegion сдвигаем на конец обработанных данных предыдущего (размер региона может быть не кратен блоку)
 		//Так же мы проверяем предыдущий символ от '\n' и если '\n' попадет на начало блока будет ошибка, сдвигаем регион еще на один символ влево
-		size_t delta_ofset_reg = 0;
-		for (size_t offset = 0; offset < file_size; offset += delta_offset) {
+		size_t offset = begin;
+		size_t delta_ofset_reg = begin ? 1 : 0;
+		while (end - offset >= 2 * block_size) {
 			
-			if (!mapped_file_.MapRegion(offset - delta_ofset_reg, (std::min)(chank_size + delta_ofset_reg, file_size - offset + delta_ofset_reg), ec)) {
+			const size_t map_size = (std::min)(chank_size + delta_ofset_reg, end - offset + delta_ofset_reg);
+			MemoryBudget::Lease lease(memory_budget_, map_size);
+			if (!mapped_file_.MapRegion(offset - delta_ofset_reg, map_size, ec)) {
 				return false;
 			}
 
-			if (mode == Mode::Flat && simd_level_ == SimdSupport::SimdLevel::AVX512) {
-				flat_chank_512(static_cast<char*>(mapped_file_.Data()) + delta_ofset_reg, mapped_file_.MapSize() - delta_ofset_reg, block_size);
-			} else if (mode == Mode::Flat && simd_level_ == SimdSupport::SimdLevel::AVX2) {
-				flat_chank_256(static_cast<char*>(mapped_file_.Data()) + delta_ofset_reg, mapped_file_.MapSize() - delta_ofset_reg, block_size);
-			} else if (mode == Mode::Flat && simd_level_ == SimdSupport::SimdLevel::None) {
-				flat_chank_none(static_cast<char*>(mapped_file_.Data()) + delta_ofset_reg, mapped_file_.MapSize() - delta_ofset_reg, block_size);
-			} else if (mode == Mode::Unflat && simd_level_ == SimdSupport::SimdLevel::AVX512) {
-				unflat_chank_512(static_cast<char*>(mapped_file_.Data()) + delta_ofset_reg, mapped_file_.MapSize() - delta_ofset_reg, block_size);
-			} else if (mode == Mode::Unflat && simd_level_ == SimdSupport::SimdLevel::AVX2) {
-				unflat_chank_256(static_cast<char*>(mapped_file_.Data()) + delta_ofset_reg, mapped_file_.MapSize() - delta_ofset_reg, block_size);
-			} else if (mode == Mode::Unflat && simd_level_ == SimdSupport::SimdLevel::None) {
-				unflat_chank_none(static_cast<char*>(mapped_file_.Data()) + delta_ofset_reg, mapped_file_.MapSize() - delta_ofset_reg, block_size);
-			}
+			//Регион без изменений не сбрасывается на диск: его страницы не были изменены
+			const size_t changes_before = changes_.Total();
+			offset += process_region(mode, static_cast<char*>(mapped_file_.Data()) + delta_ofset_reg, mapped_file_.MapSize() - delta_ofset_reg, offset, block_size);
+			mapped_file_.Unmap(changes_.Total() != changes_before);
 
 			delta_ofset_reg = 1;
 		}
 
-		//Нужно обработать данные в конце файла
-		size_t not_processed_size = file_size % block_size + block_size;
-		if (!mapped_file_.MapRegion(file_size - not_processed_size - delta_ofset_reg, not_processed_size + delta_ofset_reg, ec)) {
+		//Нужно обработать данные в конце диапазона. Для '\n' в последних символах нужна метка времени за концом диапазона
+		const size_t not_processed_size = end - offset;
+		const size_t data_size = (std::min)(end + LogEvent::TIMESTAMP_SIZE, file_size) - offset;
+		//Потребителям нужно дочитать заголовок события, начатого в конце диапазона
+		const size_t map_size = consumers_.empty() ? data_size : (std::min)(end + RegionConsumer::LOOKAHEAD, file_size) - offset;
+		if (throttle_) {
+			throttle_->Io(not_processed_size);
+		}
+		MemoryBudget::Lease lease(memory_budget_, map_size + delta_ofset_reg);
+		if (!mapped_file_.MapRegion(offset - delta_ofset_reg, map_size + delta_ofset_reg, ec)) {
 			return false;
 		}
-		flat_remainder(static_cast<char*>(mapped_file_.Data()) + delta_ofset_reg, mapped_file_.MapSize());
-		
+		char* data = static_cast<char*>(mapped_file_.Data()) + delta_ofset_reg;
+		if (hash_) {
+			hash_->Update(data, not_processed_size);
+		}
+		const size_t changes_before = changes_.Total();
+		if (!consumers_.empty()) {
+			begin_event_starts(data, not_processed_size);
+		}
+		if (mode == Mode::Flat) {
+			flat_remainder(data, data_size, changes_);
+		} else {
+			unflat_remainder(data, not_processed_size, data_size, changes_);
+		}
+		if (!consumers_.empty()) {
+			consume_slice(data, not_processed_size, map_size, offset);
+		}
+		mapped_file_.Unmap(changes_.Total() != changes_before);
+
+		for (auto consumer : consumers_) {
+			if (!consumer->End(ec)) {
+				return false;
+			}
+		}
 		return true;
 	}
 
+	size_t FlatLog::ProcessBuffer(Mode mode, char* data, size_t size, bool is_last) {
+		const size_t block_size = this->block_size();
+		size_t processed = 0;
+		if (size >= 2 * block_size) {
+			processed = process_chank(mode, data, size, block_size);
+		}
+		if (!is_last) {
+			return processed;
+		}
+		if (mode == Mode::Flat) {
+			flat_remainder(data + processed, size - processed, changes_);
+		} else {
+			unflat_remainder(data + processed, size - processed, size - processed, changes_);
+		}
+		return size;
+	}
+
+	size_t FlatLog::block_size() {
+		return (simd_level_ == SimdSupport::SimdLevel::None) ? 12 : simd_support_.BlockSize(simd_level_);
+	}
+
+	size_t FlatLog::process_chank(Mode mode, char* ch, size_t size, size_t block_size) {
+		if (mode == Mode::Flat && simd_level_ == SimdSupport::SimdLevel::AVX512) {
+			flat_chank_512(ch, size, block_size, changes_);
+		} else if (mode == Mode::Flat && simd_level_ == SimdSupport::SimdLevel::AVX2) {
+			flat_chank_256(ch, size, block_size, changes_);
+		} else if (mode == Mode::Flat && simd_level_ == SimdSupport::SimdLevel::None) {
+			flat_chank_none(ch, size, block_size, changes_);
+		} else if (mode == Mode::Unflat && simd_level_ == SimdSupport::SimdLevel::AVX512) {
+			unflat_chank_512(ch, size, block_size, changes_);
+		} else if (mode == Mode::Unflat && simd_level_ == SimdSupport::SimdLevel::AVX2) {
+			unflat_chank_256(ch, size, block_size, changes_);
+		} else if (mode == Mode::Unflat && simd_level_ == SimdSupport::SimdLevel::None) {
+			unflat_chank_none(ch, size, block_size, changes_);
+		}
+		return processed_size(size, block_size);
+	}
+
+	size_t FlatLog::process_region(Mode mode, char* ch, size_t size, size_t file_offset, size_t block_size) {
+		if (!throttle_ && !hash_ && consumers_.empty()) {
+			return process_chank(mode, ch, size, block_size);
+		}
+		//Части обрабатываются так же, как весь регион одним вызовом: каждая следующая начинается с конца обработанного
+		const size_t region_offset = ch - static_cast<char*>(mapped_file_.Data());
+		size_t processed = 0;
+		while (size - processed >= 2 * block_size) {
+			const size_t slice_size = (std::min)(SLICE_SIZE + block_size, size - processed);
+			if (hash_) {
+				//Исходные данные части хешируются до изменения, пока они в кэше процессора
+				hash_->Update(ch + processed, processed_size(slice_size, block_size));
+			}
+			if (throttle_) {
+				throttle_->Io(slice_size - block_size);
+			}
+			ThreadCpuMeter cpu(throttle_);
+			const size_t changes_before = changes_.Total();
+			if (!consumers_.empty()) {
+				begin_event_starts(ch + processed, slice_size);
+			}
+			const size_t slice_processed = process_chank(mode, ch + processed, slice_size, block_size);
+			if (!consumers_.empty()) {
+				//Часть еще в кэше процессора: потребители читают ее без повторного обращения к памяти
+				consume_slice(ch + processed, slice_processed, size - processed, file_offset + processed);
+			}
+			if (throttle_ && throttle_->IsIoLimited() && changes_.Total() != changes_before) {
+				mapped_file_.Flush(region_offset + processed, slice_processed);
+			}
+			cpu.Charge();
+			processed += slice_processed;
+		}
+		return processed;
+	}
+
+	void FlatLog::begin_event_starts(const char* data, size_t size) {
+		//Бит за концом части: событие, начинающееся в следующей
+		event_starts_buffer_.assign(size / 64 + 2, 0);
+		event_starts_ = event_starts_buffer_.data();
+		event_starts_base_ = data;
+	}
+
+	void FlatLog::consume_slice(const char* data, size_t size, size_t avail, size_t file_offset) {
+		uint64_t* event_starts = event_starts_;
+		if (carry_event_start_) {
+			mark_event_start(event_starts, 0);
+		}
+		carry_event_start_ = (event_starts[size >> 6] >> (size & 63)) & 1;
+		event_starts[size >> 6] &= ~(1ULL << (size & 63));
+		if (file_offset == range_begin_) {
+			//Первое событие файла не предваряется переводом строки, а '\n' перед началом диапазона не обрабатывался
+			const size_t start = file_offset ? 0 : LogEvent::BomSize(data, size);
+			const bool is_after_lf = !file_offset || *(data - 1) == LF;
+			if (is_after_lf && start < size && file_offset + start + LogEvent::TIMESTAMP_SIZE <= mapped_file_.FileSize()
+				&& LogEvent::IsNewEvent(data + start)) {
+				mark_event_start(event_starts, start);
+			}
+		}
+		const RegionConsumer::Slice slice{ data, size, avail, file_offset, event_starts };
+		for (auto consumer : consumers_) {
+			consumer->Consume(slice);
+		}
+		event_starts_ = nullptr;
+	}
+
+	void FlatLog::SetHash(LogHash* hash) {
+		hash_ = hash;
+	}
+
+	void FlatLog::SetThrottle(Throttle* throttle) {
+		throttle_ = throttle;
+	}
+
+	void FlatLog::SetMemoryBudget(MemoryBudget* memory_budget) {
+		memory_budget_ = memory_budget;
+	}
+
+	void FlatLog::SetDropCache(bool drop_cache) {
+		mapped_file_.SetDropCache(drop_cache);
+	}
+
 	void FlatLog::SetSimdLevel(SimdSupport::SimdLevel simd_level) {
 		simd_level_ = simd_level;
 	}
@@ -60,7 +213,12 @@ namespace soldy {
 #ifdef __linux__
 	__attribute__((target("avx512f,avx512bw")))
 #endif
-	inline void FlatLog::flat_chank_512(char* ch, size_t size, size_t block_size) {
+	inline void FlatLog::flat_chank_512(char* ch, size_t size, size_t block_size, Changes& changes) {
+		const bool is_dry_run = is_dry_run_;
+		uint64_t* const event_starts = event_starts_;
+		const char* const event_starts_base = event_starts_base_;
+		size_t lf_count = 0;
+		size_t cr_count = 0;
 		__m512i newline_mask = _mm512_set1_epi8(LF);
 		char* end = ch + ((size / block_size) - 1) * block_size;
 		for (; ch < end; ch += block_size) {
@@ -69,46 +227,81 @@ namespace soldy {
 			while (mask != 0) {
 				// Находим позицию первого установленного бита
 				size_t pos = CTZ64(mask);
-				if (!is_new_event_512(ch + pos + 1)) {
-					*(ch + pos) = CHANGE_LF;
+				if (!LogEvent::IsNewEvent512(ch + pos + 1)) {
+					++lf_count;
 					char& prev_ch = *(ch + pos - 1);
-					if (prev_ch == CR) {
-						prev_ch = CHANGE_CR;
+					cr_count += (prev_ch == CR);
+					if (!is_dry_run) {
+						*(ch + pos) = CHANGE_LF;
+						if (prev_ch == CR) {
+							prev_ch = CHANGE_CR;
+						}
 					}
+				} else if (event_starts) {
+					mark_event_start(event_starts, ch + pos + 1 - event_starts_base);
 				}
 				// Сбрасываем обработанный бит
 				mask &= ~(1ULL << pos);
 			}
 		}
+		changes.lf += lf_count;
+		changes.cr += cr_count;
 	}
 
 #ifdef __linux__
 	__attribute__((target("avx512f,avx512bw")))
 #endif
-	inline void FlatLog::unflat_chank_512(char* ch, size_t size, size_t block_size) {
+	inline void FlatLog::unflat_chank_512(char* ch, size_t size, size_t block_size, Changes& changes) {
+		const bool is_dry_run = is_dry_run_;
+		uint64_t* const event_starts = event_starts_;
+		const char* const event_starts_base = event_starts_base_;
+		size_t lf_count = 0;
+		size_t cr_count = 0;
 		__m512i newline_mask = _mm512_set1_epi8(CHANGE_LF);
+		__m512i lf_mask_value = _mm512_set1_epi8(LF);
 		char* end = ch + ((size / block_size) - 1) * block_size;
 		for (; ch < end; ch += block_size) {
 			__m512i block = _mm512_loadu_si512(reinterpret_cast<const __m512i*>(ch));
+			if (event_starts) {
+				//Оставшиеся '\n' перед меткой времени - границы событий
+				uint64_t lf_mask = _mm512_cmpeq_epi8_mask(block, lf_mask_value);
+				for (; lf_mask != 0; lf_mask &= lf_mask - 1) {
+					size_t pos = CTZ64(lf_mask);
+					if (LogEvent::IsNewEvent512(ch + pos + 1)) {
+						mark_event_start(event_starts, ch + pos + 1 - event_starts_base);
+					}
+				}
+			}
 			uint64_t  mask = _mm512_cmpeq_epi8_mask(block, newline_mask);
 			while (mask != 0) {
 				// Находим позицию первого установленного бита
 				size_t pos = CTZ64(mask);
-				*(ch + pos) = LF;
+				++lf_count;
 				char& prev_ch = *(ch + pos - 1);
-				if (prev_ch == CHANGE_CR) {
-					prev_ch = CR;
+				cr_count += (prev_ch == CHANGE_CR);
+				if (!is_dry_run) {
+					*(ch + pos) = LF;
+					if (prev_ch == CHANGE_CR) {
+						prev_ch = CR;
+					}
 				}
 				// Сбрасываем обработанный бит
 				mask &= ~(1ULL << pos);
 			}
 		}
+		changes.lf += lf_count;
+		changes.cr += cr_count;
 	}
 
 #ifdef __linux__
 	__attribute__((target("avx2")))
 #endif
-	inline void FlatLog::flat_chank_256(char* ch, size_t size, size_t block_size) {
+	inline void FlatLog::flat_chank_256(char* ch, size_t size, size_t block_size, Changes& changes) {
+		const bool is_dry_run = is_dry_run_;
+		uint64_t* const event_starts = event_starts_;
+		const char* const event_starts_base = event_starts_base_;
+		size_t lf_count = 0;
+		size_t cr_count = 0;
 		__m256i newline_mask = _mm256_set1_epi8(LF);
 		char* end = ch + ((size / block_size) - 1) * block_size;
 
@@ -119,160 +312,141 @@ namespace soldy {
 			while (mask != 0) {
 				// Находим позицию первого установленного бита
 				size_t pos = CTZ32(mask);
-				if (!is_new_event_256(ch + pos + 1)) {
-					*(ch + pos) = CHANGE_LF;
+				if (!LogEvent::IsNewEvent256(ch + pos + 1)) {
+					++lf_count;
 					char& prev_ch = *(ch + pos - 1);
-					if (prev_ch == CR) {
-						prev_ch = CHANGE_CR;
+					cr_count += (prev_ch == CR);
+					if (!is_dry_run) {
+						*(ch + pos) = CHANGE_LF;
+						if (prev_ch == CR) {
+							prev_ch = CHANGE_CR;
+						}
 					}
+				} else if (event_starts) {
+					mark_event_start(event_starts, ch + pos + 1 - event_starts_base);
 				}
 				// Сбрасываем обработанный бит
 				mask &= ~(1U << pos);
 			}
 		}
+		changes.lf += lf_count;
+		changes.cr += cr_count;
 	}
 
 #ifdef __linux__
 	__attribute__((target("avx2")))
 #endif
-	inline void FlatLog::unflat_chank_256(char* ch, size_t size, size_t block_size) {
+	inline void FlatLog::unflat_chank_256(char* ch, size_t size, size_t block_size, Changes& changes) {
+		const bool is_dry_run = is_dry_run_;
+		uint64_t* const event_starts = event_starts_;
+		const char* const event_starts_base = event_starts_base_;
+		size_t lf_count = 0;
+		size_t cr_count = 0;
 		__m256i newline_mask = _mm256_set1_epi8(CHANGE_LF);
+		__m256i lf_mask_value = _mm256_set1_epi8(LF);
 		char* end = ch + ((size / block_size) - 1) * block_size;
 
 		for (; ch < end; ch += block_size) {
 			__m256i block = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(ch));
+			if (event_starts) {
+				//Оставшиеся '\n' перед меткой времени - границы событий
+				uint32_t lf_mask = _mm256_movemask_epi8(_mm256_cmpeq_epi8(block, lf_mask_value));
+				for (; lf_mask != 0; lf_mask &= lf_mask - 1) {
+					size_t pos = CTZ32(lf_mask);
+					if (LogEvent::IsNewEvent256(ch + pos + 1)) {
+						mark_event_start(event_starts, ch + pos + 1 - event_starts_base);
+					}
+				}
+			}
 			uint32_t mask = _mm256_movemask_epi8(_mm256_cmpeq_epi8(block, newline_mask));
 
 			while (mask != 0) {
 				// Находим позицию первого установленного бита
 				size_t pos = CTZ32(mask);
-				*(ch + pos) = LF;
+				++lf_count;
 				char& prev_ch = *(ch + pos - 1);
-				if (prev_ch == CHANGE_CR) {
-					prev_ch = CR;
+				cr_count += (prev_ch == CHANGE_CR);
+				if (!is_dry_run) {
+					*(ch + pos) = LF;
+					if (prev_ch == CHANGE_CR) {
+						prev_ch = CR;
+					}
 				}
 				// Сбрасываем обработанный бит
 				mask &= ~(1U << pos);
 			}
 		}
+		changes.lf += lf_count;
+		changes.cr += cr_count;
 	}
 
-	inline void FlatLog::flat_chank_none(char* ch, size_t size, size_t block_size) {
+	inline void FlatLog::flat_chank_none(char* ch, size_t size, size_t block_size, Changes& changes) {
 		char* end = ch + ((size / block_size) - 1) * block_size;
-		for (; ch < end; ++ch) {
-			if (*ch == LF && !is_new_event(ch + 1)) {
-				*(ch) = CHANGE_LF;
-				if (*(ch - 1) == CR) {
-					*(ch - 1) = CHANGE_CR;
-				}
-			}
-		}
+		flat_bytes(ch, end, changes);
 	}
 
-	inline void FlatLog::unflat_chank_none(char* ch, size_t size, size_t block_size) {
+	inline void FlatLog::unflat_chank_none(char* ch, size_t size, size_t block_size, Changes& changes) {
 		char* end = ch + ((size / block_size) - 1) * block_size;
-		for (; ch < end; ++ch) {
-			if (*ch == CHANGE_LF) {
-				*(ch) = LF;
-				if (*(ch - 1) == CHANGE_CR) {
-					*(ch - 1) = CR;
-				}
-			}
-		}
+		unflat_bytes(ch, end, ch + size, changes);
 	}
 
-#ifdef __linux__
-	__attribute__((target("avx512f,avx512bw")))
-#endif
-	inline bool FlatLog::is_new_event_512(char* ch) {
-		//19:00.501005 - признак нового события 12 символов
-		static const __m512i zero = _mm512_set1_epi8('0');
-		static const __m512i nine = _mm512_set1_epi8('9');
-		static const __m512i colon = _mm512_set1_epi8(':');
-		static const __m512i dot = _mm512_set1_epi8('.');
-		static const __mmask64 pattern_mask =
-			(1ULL << 0) | (1ULL << 1) |   // \d\d
-			(1ULL << 3) | (1ULL << 4) |   // :\d\d  
-			(1ULL << 6) | (1ULL << 7) | (1ULL << 8) |
-			(1ULL << 9) | (1ULL << 10) | (1ULL << 11);  // \.\d{6}
-
-		__m512i data = _mm512_loadu_si512(reinterpret_cast<const __m512i*>(ch));
-		__mmask64 is_digit_mask = _mm512_cmple_epu8_mask(data, nine) &
-			_mm512_cmpge_epu8_mask(data, zero);
-
-		if ((is_digit_mask & pattern_mask) != pattern_mask) {
-			return false;
+	void FlatLog::flat_remainder(char* ch, size_t size, Changes& changes) {
+		//19:00.501005 - 12 символов
+		static const size_t lenght_is_new_line = 12;
+		if (size <= lenght_is_new_line) {
+			return;
 		}
+		flat_bytes(ch, ch + size - lenght_is_new_line, changes);
+	}
 
-		__mmask64 colon_mask = _mm512_cmpeq_epi8_mask(data, colon);
-		__mmask64 dot_mask = _mm512_cmpeq_epi8_mask(data, dot);
-
-		return (colon_mask & (1ULL << 2)) && (dot_mask & (1ULL << 5));
+	void FlatLog::unflat_remainder(char* ch, size_t size, size_t avail, Changes& changes) {
+		unflat_bytes(ch, ch + size, ch + avail, changes);
 	}
 
-#ifdef __linux__
-	__attribute__((target("avx2")))
-#endif
-	inline bool FlatLog::is_new_event_256(char* ch) {
-		//19:00.501005 - признак нового события 12 символов
-		static const __m256i zero = _mm256_set1_epi8('0');
-		static const __m256i nine = _mm256_set1_epi8('9');
-		static const __m256i colon = _mm256_set1_epi8(':');
-		static const __m256i dot = _mm256_set1_epi8('.');
-		static const uint32_t pattern_mask =
-			(1U << 0) | (1U << 1) |   // \d\d
-			(1U << 3) | (1U << 4) |   // :\d\d  
-			(1U << 6) | (1U << 7) | (1U << 8) |
-			(1U << 9) | (1U << 10) | (1U << 11);  // \.\d{6}
-
-		__m256i data = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(ch));
-
-		// Проверка цифр: data >= '0' && data <= '9'
-		__m256i ge_zero = _mm256_cmpeq_epi8(_mm256_max_epu8(data, zero), data); // data >= '0'
-		__m256i le_nine = _mm256_cmpeq_epi8(_mm256_min_epu8(data, nine), data); // data <= '9'
-		__m256i is_digit = _mm256_and_si256(ge_zero, le_nine);
-		uint32_t is_digit_mask = _mm256_movemask_epi8(is_digit);
-
-		if ((is_digit_mask & pattern_mask) != pattern_mask) {
-			return false;
+	void FlatLog::flat_bytes(char* ch, char* end, Changes& changes) {
+		const bool is_dry_run = is_dry_run_;
+		uint64_t* const event_starts = event_starts_;
+		const char* const event_starts_base = event_starts_base_;
+		for (; ch < end; ++ch) {
+			if (*ch != LF) {
+				continue;
+			}
+			if (LogEvent::IsNewEvent(ch + 1)) {
+				if (event_starts) {
+					mark_event_start(event_starts, ch + 1 - event_starts_base);
+				}
+			} else {
+				++changes.lf;
+				if (*(ch - 1) == CR) {
+					++changes.cr;
+					if (!is_dry_run) {
+						*(ch - 1) = CHANGE_CR;
+					}
+				}
+				if (!is_dry_run) {
+					*(ch) = CHANGE_LF;
+				}
+			}
 		}
-
-		// Проверка двоеточия и точки
-		__m256i is_colon = _mm256_cmpeq_epi8(data, colon);
-		__m256i is_dot = _mm256_cmpeq_epi8(data, dot);
-		uint32_t colon_mask = _mm256_movemask_epi8(is_colon);
-		uint32_t dot_mask = _mm256_movemask_epi8(is_dot);
-
-		return (colon_mask & (1U << 2)) && (dot_mask & (1U << 5));
 	}
-	
-	inline bool FlatLog::is_new_event(char* ch) {
-		//19:00.501005 - признак нового события 12 символов
-		return
-			*ch >= '0' && *ch <= '9'
-			&& *(ch + 1) >= '0' && *(ch + 1) <= '9'
-			&& *(ch + 2) == ':'
-			&& *(ch + 3) >= '0' && *(ch + 3) <= '9'
-			&& *(ch + 4) >= '0' && *(ch + 4) <= '9'
-			&& *(ch + 5) == '.'
-			&& *(ch + 6) >= '0' && *(ch + 6) <= '9'
-			&& *(ch + 7) >= '0' && *(ch + 7) <= '9'
-			&& *(ch + 8) >= '0' && *(ch + 8) <= '9'
-			&& *(ch + 9) >= '0' && *(ch + 9) <= '9'
-			&& *(ch + 10) >= '0' && *(ch + 10) <= '9'
-			&& *(ch + 11) >= '0' && *(ch + 11) <= '9';
-	}
-
-	void FlatLog::flat_remainder(char* ch, size_t size) {
-		//19:00.501005 - 12 символов
-		static const size_t lenght_is_new_line = 12;
 
-		char* end = ch + size - lenght_is_new_line;
+	void FlatLog::unflat_bytes(char* ch, char* end, const char* limit, Changes& changes) {
+		const bool is_dry_run = is_dry_run_;
+		uint64_t* const event_starts = event_starts_;
+		const char* const event_starts_base = event_starts_base_;
 		for (; ch < end; ++ch) {
-			if (*ch == LF && !is_new_event(ch + 1)) {
-				*(ch) = CHANGE_LF;
-				if (*(ch - 1) == CR) {
-					*(ch - 1) = CHANGE_CR;
+			if (event_starts && *ch == LF && ch + 1 + LogEvent::TIMESTAMP_SIZE <= limit && LogEvent::IsNewEvent(ch + 1)) {
+				mark_event_start(event_starts, ch + 1 - event_starts_base);
+			} else if (*ch == CHANGE_LF) {
+				++changes.lf;
+				if (*(ch - 1) == CHANGE_CR) {
+					++changes.cr;
+					if (!is_dry_run) {
+						*(ch - 1) = CR;
+					}
+				}
+				if (!is_dry_run) {
+					*(ch) = LF;
 				}
 			}
 		}
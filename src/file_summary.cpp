@@ -0,0 +1,217 @@
+#include "file_summary.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include "log_event.h"
+#include "log_discovery.h"
+
+namespace soldy {
+
+	namespace {
+		const char MAGIC[8] = { 'F', 'L', 'A', 'T', 'S', 'U', 'M', '1' };
+		//Самый длинный образец ",t:connectID=" вместе со значением
+		const size_t CARRY_SIZE = 32 + FileSummary::MAX_VALUE_SIZE;
+	}
+
+	const std::vector<std::string>& FileSummary::Properties() {
+		static const std::vector<std::string> properties = { "SessionID", "t:connectID", "t:clientID", "Usr" };
+		return properties;
+	}
+
+	bool FileSummary::IsSummarized(std::string_view property) {
+		const auto& properties = Properties();
+		return std::find(properties.begin(), properties.end(), property) != properties.end();
+	}
+
+	std::filesystem::path FileSummary::SidecarPath(const std::filesystem::path& file) {
+		std::filesystem::path sidecar = file;
+		sidecar += L".sum";
+		return sidecar;
+	}
+
+	FileSummary::FileSummary(SimdSupport::SimdLevel simd_level) : simd_level_(simd_level) {
+		for (const auto& property : Properties()) {
+			finders_.emplace_back("," + property + "=", simd_level);
+		}
+	}
+
+	void FileSummary::Begin(const std::filesystem::path& file, size_t file_size) {
+		file_ = file;
+		file_size_ = file_size;
+		const std::wstring hour = LogDiscovery::HourOf(file);
+		hour_time_ = hour.empty() ? 0 : std::stoull(hour) * 3600ULL * 1000000ULL;
+		events_ = 0;
+		min_time_ = NO_TIME;
+		max_time_ = 0;
+		keys_.clear();
+		carry_.clear();
+		event_counter_ = EventCounter();
+		event_counter_.Begin(file, file_size);
+	}
+
+	void FileSummary::Consume(const Slice& slice) {
+		event_counter_.Consume(slice);
+
+		//Метка времени начала события целиком доступна: ядро проверило ее при поиске начала
+		const size_t words = (slice.size + 63) / 64;
+		for (size_t w = 0; w < words; ++w) {
+			for (uint64_t bits = slice.event_starts[w]; bits; bits &= bits - 1) {
+				const uint64_t time = hour_time_ + LogEvent::Timestamp(slice.data + w * 64 + CTZ64(bits));
+				min_time_ = (std::min)(min_time_, time);
+				max_time_ = (std::max)(max_time_, time);
+				++events_;
+			}
+		}
+
+		const bool is_file_end = slice.offset + slice.avail >= file_size_;
+		if (!carry_.empty()) {
+			const size_t head = (std::min)(slice.avail, CARRY_SIZE);
+			carry_.append(slice.data, head);
+			find_properties(carry_.data(), carry_.size(), carry_.size(), is_file_end && head == slice.avail);
+		}
+		find_properties(slice.data, slice.size, (std::min)(slice.avail, slice.size + CARRY_SIZE), is_file_end && slice.avail <= slice.size + CARRY_SIZE);
+		const size_t tail = (std::min)(slice.size, CARRY_SIZE);
+		carry_.assign(slice.data + slice.size - tail, tail);
+	}
+
+	void FileSummary::find_properties(const char* data, size_t size, size_t avail, bool is_file_end) {
+		//Образец начинается в [data, data + size), значение дочитывается до data + avail.
+		//Одно значение может быть найдено дважды (в части и на стыке) - для фильтра это не важно
+		const char* end = data + avail;
+		for (size_t i = 0; i < finders_.size(); ++i) {
+			const char* ch = data;
+			while ((ch = finders_[i].Find(ch, end)) != nullptr && ch < data + size) {
+				const char* value = ch + finders_[i].Size();
+				const char* value_end = LogEvent::PropertyValueEnd(value, end);
+				if ((value_end < end || is_file_end) && static_cast<size_t>(value_end - value) <= MAX_VALUE_SIZE) {
+					keys_.insert(key_hash(Properties()[i], std::string_view(value, value_end - value)));
+				}
+				ch = value;
+			}
+		}
+	}
+
+	bool FileSummary::End(std::error_code& ec) {
+		event_counter_.End(ec);
+		for (const auto& [name, item] : event_counter_.Items()) {
+			keys_.insert(key_hash({}, name));
+		}
+
+		const size_t bit_count = (std::max)(static_cast<size_t>(64), keys_.size() * BITS_PER_KEY);
+		bits_.assign((bit_count + 63) / 64, 0);
+		const uint64_t bit_size = bits_.size() * 64;
+		for (uint64_t hash : keys_) {
+			const uint64_t h1 = hash;
+			const uint64_t h2 = (hash >> 32) | 1;
+			for (uint32_t i = 0; i < HASH_COUNT; ++i) {
+				const uint64_t bit = (h1 + i * h2) % bit_size;
+				bits_[bit >> 6] |= 1ULL << (bit & 63);
+			}
+		}
+		keys_.clear();
+
+		std::ofstream stream(SidecarPath(file_), std::ios::binary | std::ios::trunc);
+		if (!stream) {
+			ec = std::make_error_code(std::errc::permission_denied);
+			return false;
+		}
+		const uint64_t word_count = bits_.size();
+		stream.write(MAGIC, sizeof(MAGIC));
+		stream.write(reinterpret_cast<const char*>(&file_size_), sizeof(file_size_));
+		stream.write(reinterpret_cast<const char*>(&events_), sizeof(events_));
+		stream.write(reinterpret_cast<const char*>(&min_time_), sizeof(min_time_));
+		stream.write(reinterpret_cast<const char*>(&max_time_), sizeof(max_time_));
+		stream.write(reinterpret_cast<const char*>(&word_count), sizeof(word_count));
+		stream.write(reinterpret_cast<const char*>(bits_.data()), word_count * sizeof(uint64_t));
+		if (!stream.flush()) {
+			ec = std::make_error_code(std::errc::io_error);
+			return false;
+		}
+		return true;
+	}
+
+	bool FileSummary::Load(const std::filesystem::path& file, std::error_code& ec) {
+		const uint64_t file_size = std::filesystem::file_size(file, ec);
+		if (ec) {
+			return false;
+		}
+		std::ifstream stream(SidecarPath(file), std::ios::binary);
+		if (!stream) {
+			ec = std::make_error_code(std::errc::no_such_file_or_directory);
+			return false;
+		}
+		char magic[sizeof(MAGIC)];
+		uint64_t word_count = 0;
+		stream.read(magic, sizeof(magic));
+		stream.read(reinterpret_cast<char*>(&file_size_), sizeof(file_size_));
+		stream.read(reinterpret_cast<char*>(&events_), sizeof(events_));
+		stream.read(reinterpret_cast<char*>(&min_time_), sizeof(min_time_));
+		stream.read(reinterpret_cast<char*>(&max_time_), sizeof(max_time_));
+		stream.read(reinterpret_cast<char*>(&word_count), sizeof(word_count));
+		if (!stream || std::memcmp(magic, MAGIC, sizeof(MAGIC)) != 0 || !word_count || word_count > file_size + 1) {
+			ec = std::make_error_code(std::errc::invalid_argument);
+			return false;
+		}
+		if (file_size_ != file_size) {
+			ec = std::make_error_code(std::errc::invalid_argument);
+			return false;
+		}
+		bits_.resize(word_count);
+		stream.read(reinterpret_cast<char*>(bits_.data()), word_count * sizeof(uint64_t));
+		if (!stream) {
+			ec = std::make_error_code(std::errc::invalid_argument);
+			return false;
+		}
+		file_ = file;
+		return true;
+	}
+
+	bool FileSummary::MayContain(std::string_view property, std::string_view value) const {
+		if (!IsSummarized(property) || value.size() > MAX_VALUE_SIZE) {
+			return true;
+		}
+		return may_contain(key_hash(property, value));
+	}
+
+	bool FileSummary::MayContainEvent(std::string_view name) const {
+		return may_contain(key_hash({}, name));
+	}
+
+	bool FileSummary::may_contain(uint64_t hash) const {
+		if (bits_.empty()) {
+			return true;
+		}
+		const uint64_t bit_size = bits_.size() * 64;
+		const uint64_t h1 = hash;
+		const uint64_t h2 = (hash >> 32) | 1;
+		for (uint32_t i = 0; i < HASH_COUNT; ++i) {
+			const uint64_t bit = (h1 + i * h2) % bit_size;
+			if (!((bits_[bit >> 6] >> (bit & 63)) & 1)) {
+				return false;
+			}
+		}
+		return true;
+	}
+
+	uint64_t FileSummary::key_hash(std::string_view property, std::string_view value) {
+		//FNV-1a и перемешивание: одинаковый результат на всех платформах. Имя события - ключ с пустым свойством
+		uint64_t hash = 0xcbf29ce484222325ULL;
+		auto add = [&hash](std::string_view str) {
+			for (unsigned char ch : str) {
+				hash ^= ch;
+				hash *= 0x100000001b3ULL;
+			}
+		};
+		add(property);
+		add("=");
+		add(value);
+		hash ^= hash >> 33;
+		hash *= 0xff51afd7ed558ccdULL;
+		hash ^= hash >> 33;
+		hash *= 0xc4ceb9fe1a85ec53ULL;
+		hash ^= hash >> 33;
+		return hash;
+	}
+
+}
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <filesystem>
+#include <limits>
+#include <string>
+#include <string_view>
+#include <unordered_set>
+#include <vector>
+#include <system_error>
+#include "region_consumer.h"
+#include "event_counter.h"
+#include "substring_finder.h"
+
+namespace soldy {
+
+	//Сводка файла журнала (<файл>.sum) для пропуска файлов при поиске без их чтения: фильтр Блума по значениям
+	//свойств Properties() и именам событий, количество событий и минимальное/максимальное время.
+	//Строится за тот же проход, что и преобразование (RegionConsumer). Ложных отрицаний фильтр не дает:
+	//если MayContain вернул false, значения в файле нет.
+	class FileSummary : public RegionConsumer {
+	public:
+		//Значения длиннее в фильтр не попадают, для них MayContain всегда true
+		static constexpr size_t MAX_VALUE_SIZE = 256;
+		static constexpr size_t BITS_PER_KEY = 10;
+		static constexpr uint32_t HASH_COUNT = 7;
+		static constexpr uint64_t NO_TIME = (std::numeric_limits<uint64_t>::max)();
+
+		//Свойства, значения которых попадают в фильтр
+		static const std::vector<std::string>& Properties();
+		static bool IsSummarized(std::string_view property);
+		static std::filesystem::path SidecarPath(const std::filesystem::path& file);
+
+		explicit FileSummary(SimdSupport::SimdLevel simd_level);
+
+		void Begin(const std::filesystem::path& file, size_t file_size) override;
+		void Consume(const Slice& slice) override;
+		bool End(std::error_code& ec) override;
+
+		//Загружает сводку, если она построена для файла текущего размера (дописанный файл - устаревшая сводка)
+		bool Load(const std::filesystem::path& file, std::error_code& ec);
+		bool MayContain(std::string_view property, std::string_view value) const;
+		bool MayContainEvent(std::string_view name) const;
+		uint64_t Events() const noexcept { return events_; }
+		//Время события: час из имени файла YYMMDDHH * 3600000000 + микросекунды от начала часа
+		uint64_t MinTime() const noexcept { return min_time_; }
+		uint64_t MaxTime() const noexcept { return max_time_; }
+	private:
+		SimdSupport::SimdLevel simd_level_;
+		std::vector<SubstringFinder> finders_;
+		std::filesystem::path file_;
+		uint64_t file_size_ = 0;
+		uint64_t hour_time_ = 0;
+		uint64_t events_ = 0;
+		uint64_t min_time_ = NO_TIME;
+		uint64_t max_time_ = 0;
+		std::vector<uint64_t> bits_;
+		//Хеши ключей до построения фильтра: размер фильтра зависит от числа разных ключей
+		std::unordered_set<uint64_t> keys_;
+		EventCounter event_counter_;
+		//Конец предыдущей части: свойство на границе частей ищется в нем вместе с началом следующей
+		std::string carry_;
+		void find_properties(const char* data, size_t size, size_t avail, bool is_file_end);
+		bool may_contain(uint64_t hash) const;
+		static uint64_t key_hash(std::string_view property, std::string_view value);
+	};
+
+}
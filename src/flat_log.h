@@ -8,48 +8,96 @@
 #include <immintrin.h>
 #include "mapped_file.h"
 #include "simd_support.h"
-
-#ifdef _WIN32
-#include <intrin.h>
-#define CTZ64 _tzcnt_u64
-#define CTZ32 _tzcnt_u32
-#else
-#define CTZ64 __builtin_ctzll
-#define CTZ32 __builtin_ctz
-#endif
+#include "log_event.h"
+#include "memory_budget.h"
+#include "throttle.h"
+#include "log_hash.h"
+#include "region_consumer.h"
+#include <vector>
 
 namespace soldy {
 		
 	class FlatLog {
+	public:
+		enum class Mode {
+			Flat,
+			Unflat
+		};
+		//Количество измененных (в режиме dry-run - подлежащих изменению) символов
+		struct Changes {
+			size_t lf = 0;
+			size_t cr = 0;
+			size_t Total() const noexcept { return lf + cr; }
+		};
 	private:
-		static const char CR = '\r';
-		static const char LF = '\n';
-		static const char CHANGE_CR = 0x01;
-		static const char CHANGE_LF = 0x02;
+		static const char CR = LogEvent::CR;
+		static const char LF = LogEvent::LF;
+		static const char CHANGE_CR = LogEvent::CHANGE_CR;
+		static const char CHANGE_LF = LogEvent::CHANGE_LF;
 
 		std::filesystem::path file_path_;
 		MappedFile mapped_file_;
 		SimdSupport simd_support_;
 		SimdSupport::SimdLevel simd_level_;
-		inline void flat_chank_512(char* ch, size_t size, size_t block_size);
-		inline void unflat_chank_512(char* ch, size_t size, size_t block_size);
-		inline void flat_chank_256(char* ch, size_t size, size_t block_size);
-		inline void unflat_chank_256(char* ch, size_t size, size_t block_size);
-		inline void flat_chank_none(char* ch, size_t size, size_t block_size);
-		inline void unflat_chank_none(char* ch, size_t size, size_t block_size);
-		inline bool is_new_event_512(char* ch);
-		inline bool is_new_event_256(char* ch);
-		inline bool is_new_event(char* ch);
-		void flat_remainder(char* ch, size_t size);
+		MemoryBudget* memory_budget_ = nullptr;
+		Throttle* throttle_ = nullptr;
+		LogHash* hash_ = nullptr;
+		bool is_dry_run_ = false;
+		Changes changes_;
+		std::vector<RegionConsumer*> consumers_;
+		//Начала событий текущей части для потребителей: заполняются ядрами, пока event_starts_ не nullptr
+		std::vector<uint64_t> event_starts_buffer_;
+		uint64_t* event_starts_ = nullptr;
+		const char* event_starts_base_ = nullptr;
+		//Событие начинается сразу за концом предыдущей части
+		bool carry_event_start_ = false;
+		size_t range_begin_ = 0;
+		inline void flat_chank_512(char* ch, size_t size, size_t block_size, Changes& changes);
+		inline void unflat_chank_512(char* ch, size_t size, size_t block_size, Changes& changes);
+		inline void flat_chank_256(char* ch, size_t size, size_t block_size, Changes& changes);
+		inline void unflat_chank_256(char* ch, size_t size, size_t block_size, Changes& changes);
+		inline void flat_chank_none(char* ch, size_t size, size_t block_size, Changes& changes);
+		inline void unflat_chank_none(char* ch, size_t size, size_t block_size, Changes& changes);
+		void flat_remainder(char* ch, size_t size, Changes& changes);
+		void unflat_remainder(char* ch, size_t size, size_t avail, Changes& changes);
+		void flat_bytes(char* ch, char* end, Changes& changes);
+		void unflat_bytes(char* ch, char* end, const char* limit, Changes& changes);
+		size_t block_size();
+		size_t process_chank(Mode mode, char* ch, size_t size, size_t block_size);
+		size_t process_region(Mode mode, char* ch, size_t size, size_t file_offset, size_t block_size);
+		void begin_event_starts(const char* data, size_t size);
+		void consume_slice(const char* data, size_t size, size_t avail, size_t file_offset);
+		static void mark_event_start(uint64_t* event_starts, size_t i) { event_starts[i >> 6] |= 1ULL << (i & 63); }
+		//Последний блок не обрабатывается: для него нужны данные следующего
+		static size_t processed_size(size_t size, size_t block_size) { return ((size / block_size) - 1) * block_size; }
 	public:
-		enum class Mode {
-			Flat,
-			Unflat
-		};
+		//При ограничении скорости, подсчете хеша или подключенных потребителях регион обрабатывается частями такого размера
+		static constexpr size_t SLICE_SIZE = 4 * 1024 * 1024;
+
 		explicit FlatLog(const std::string& path_str);
 		bool Open(std::error_code& ec);
 		bool ProcessData(Mode mode, size_t chank_size, std::error_code& ec);
+		//Обработка части файла [begin, end): меняются только символы из нее, данные за end только читаются.
+		//Граница не должна разрывать пару CR LF, см. ShardPlan::FindBoundary.
+		bool ProcessRange(Mode mode, size_t begin, size_t end, size_t chank_size, std::error_code& ec);
+		//Обработка фрагмента потока (сжатые журналы). Перед data должен быть доступен один символ.
+		//Возвращает размер обработанной части, необработанный хвост передается в начале следующего фрагмента.
+		size_t ProcessBuffer(Mode mode, char* data, size_t size, bool is_last);
 		void SetSimdLevel(SimdSupport::SimdLevel simd_level);
+		//Общий лимит спроецированной памяти для всех потоков (nullptr - без ограничения)
+		void SetMemoryBudget(MemoryBudget* memory_budget);
+		void SetDropCache(bool drop_cache);
+		//Общее ограничение скорости ввода-вывода и загрузки процессора (nullptr - без ограничения)
+		void SetThrottle(Throttle* throttle);
+		//Хеш исходных данных (до преобразования) для последующей проверки в режиме verify.
+		//Считается только при обработке файла целиком.
+		void SetHash(LogHash* hash);
+		//Только подсчет изменений: файл открывается на чтение и не меняется. Вызывается до Open.
+		void SetDryRun(bool is_dry_run) { is_dry_run_ = is_dry_run; }
+		const Changes& GetChanges() const noexcept { return changes_; }
+		//Потребитель получает каждую обработанную часть файла вместе с началами событий, найденными ядром.
+		//Begin/End вызываются в начале и в конце ProcessRange. Сжатые журналы (ProcessBuffer) потребителям не передаются.
+		void AddConsumer(RegionConsumer* consumer) { consumers_.push_back(consumer); }
 		size_t FileSize() { return mapped_file_.FileSize(); }
 	};
 
@@ -0,0 +1,162 @@
+#include "log_compactor.h"
+
+#include <algorithm>
+#include <cstring>
+#include <memory>
+#include "event_reader.h"
+
+namespace soldy {
+
+	LogCompactor::LogCompactor(const RetentionRule& rule, SimdSupport::SimdLevel simd_level)
+		: rule_(rule), simd_level_(simd_level) {
+	}
+
+	bool LogCompactor::Compact(const std::filesystem::path& file, const std::filesystem::path& output, bool is_dry_run, std::error_code& ec) {
+		const bool is_in_place = output.empty();
+		if (out_.is_open()) {
+			out_.close();
+		}
+		out_.clear();
+		buffered_ = 0;
+		write_pos_ = 0;
+		events_ = dropped_events_ = 0;
+
+		auto reader = std::make_unique<EventReader>(simd_level_);
+		if (!reader->Open(file, ec)) {
+			return false;
+		}
+		input_size_ = reader->FileSize();
+		if (!is_dry_run) {
+			buffer_.resize(BUFFER_SIZE);
+		}
+
+		//На месте: пока ничего не удалено, события уже там, где должны быть, и запись не нужна
+		bool is_shifted = !is_in_place;
+		size_t kept_size = 0;
+		bool is_first = true;
+		while (reader->Next(ec)) {
+			if (is_first) {
+				//BOM или хвост события перед первым событием сохраняется как есть
+				kept_size = reader->Offset();
+				if (!is_dry_run && !is_in_place) {
+					out_.open(output, std::ios::out | std::ios::binary | std::ios::trunc);
+					if (!out_ || !copy_prefix(file, kept_size, ec)) {
+						ec = ec ? ec : std::make_error_code(std::errc::permission_denied);
+						return false;
+					}
+				}
+				write_pos_ = kept_size;
+				is_first = false;
+			}
+			++events_;
+			if (rule_.IsDropped(reader->Data(), reader->Size())) {
+				++dropped_events_;
+				if (!is_shifted) {
+					is_shifted = true;
+					if (!is_dry_run) {
+						if (!is_unchanged(file, ec)) {
+							return false;
+						}
+						out_.open(file, std::ios::in | std::ios::out | std::ios::binary);
+						if (!out_) {
+							ec = std::make_error_code(std::errc::permission_denied);
+							return false;
+						}
+					}
+				}
+				continue;
+			}
+			kept_size += reader->Size();
+			if (!is_shifted) {
+				write_pos_ = kept_size;
+			}
+			else if (!is_dry_run && !append(reader->Data(), reader->Size(), ec)) {
+				return false;
+			}
+		}
+		if (ec) {
+			return false;
+		}
+		if (is_first) {
+			//Событий нет: файл переносится целиком
+			kept_size = input_size_;
+			if (!is_dry_run && !is_in_place) {
+				out_.open(output, std::ios::out | std::ios::binary | std::ios::trunc);
+				if (!out_ || !copy_prefix(file, kept_size, ec)) {
+					ec = ec ? ec : std::make_error_code(std::errc::permission_denied);
+					return false;
+				}
+			}
+		}
+		output_size_ = is_in_place && !is_shifted ? input_size_ : kept_size;
+		if (is_dry_run || !is_shifted) {
+			return true;
+		}
+
+		if (!flush(ec)) {
+			return false;
+		}
+		out_.close();
+		reader.reset();
+		if (is_in_place && is_unchanged(file, ec)) {
+			std::filesystem::resize_file(file, output_size_, ec);
+		}
+		return !ec;
+	}
+
+	//Файл дописан после открытия (его еще пишет сервер 1С): EventReader видит только размер при открытии,
+	//и обрезка удалила бы дописанные события. Такой файл на месте не сжимается
+	bool LogCompactor::is_unchanged(const std::filesystem::path& file, std::error_code& ec) {
+		const uintmax_t size = std::filesystem::file_size(file, ec);
+		if (!ec && size != input_size_) {
+			ec = std::make_error_code(std::errc::text_file_busy);
+		}
+		return !ec;
+	}
+
+	//Запись идет блоками через буфер: на месте данные копируются в буфер до записи,
+	//поэтому запись (всегда левее чтения) не затирает еще не прочитанное
+	bool LogCompactor::append(const char* data, size_t size, std::error_code& ec) {
+		while (size) {
+			const size_t size_copy = (std::min)(size, BUFFER_SIZE - buffered_);
+			std::memcpy(buffer_.data() + buffered_, data, size_copy);
+			buffered_ += size_copy;
+			data += size_copy;
+			size -= size_copy;
+			if (buffered_ == BUFFER_SIZE && !flush(ec)) {
+				return false;
+			}
+		}
+		return true;
+	}
+
+	bool LogCompactor::flush(std::error_code& ec) {
+		if (!buffered_) {
+			return true;
+		}
+		out_.seekp(static_cast<std::streamoff>(write_pos_));
+		out_.write(buffer_.data(), static_cast<std::streamsize>(buffered_));
+		if (!out_) {
+			ec = std::make_error_code(std::errc::io_error);
+			return false;
+		}
+		write_pos_ += buffered_;
+		buffered_ = 0;
+		return true;
+	}
+
+	bool LogCompactor::copy_prefix(const std::filesystem::path& file, size_t size, std::error_code& ec) {
+		std::ifstream in(file, std::ios::binary);
+		std::vector<char> chunk((std::min)(size, BUFFER_SIZE));
+		while (size) {
+			const size_t size_read = (std::min)(size, chunk.size());
+			if (!in.read(chunk.data(), static_cast<std::streamsize>(size_read)) || !out_.write(chunk.data(), static_cast<std::streamsize>(size_read))) {
+				ec = std::make_error_code(std::errc::io_error);
+				return false;
+			}
+			size -= size_read;
+		}
+		return true;
+	}
+
+}
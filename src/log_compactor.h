@@ -0,0 +1,45 @@
+#pragma once
+
+#include <filesystem>
+#include <fstream>
+#include <vector>
+#include <system_error>
+#include "simd_support.h"
+#include "retention_rule.h"
+
+namespace soldy {
+
+	//Удаление событий по правилу хранения. Файл читается окнами EventReader, сохраняемые события пишутся
+	//большими последовательными блоками: на место (запись всегда позади чтения, затем файл обрезается)
+	//или в новый файл. На месте файл не переписывается, пока не встретится первое удаляемое событие.
+	//Прерванное сжатие на месте оставляет файл испорченным - для архивов без копии используйте новый файл.
+	//Если файл изменил размер во время сжатия на месте, сжатие прерывается до записи или до обрезки.
+	class LogCompactor {
+	public:
+		static constexpr size_t BUFFER_SIZE = 4 * 1024 * 1024;
+
+		LogCompactor(const RetentionRule& rule, SimdSupport::SimdLevel simd_level);
+		//output пустой - сжатие на месте. В режиме dry-run только считается результат
+		bool Compact(const std::filesystem::path& file, const std::filesystem::path& output, bool is_dry_run, std::error_code& ec);
+		size_t InputSize() const noexcept { return input_size_; }
+		size_t OutputSize() const noexcept { return output_size_; }
+		size_t Events() const noexcept { return events_; }
+		size_t DroppedEvents() const noexcept { return dropped_events_; }
+	private:
+		const RetentionRule& rule_;
+		SimdSupport::SimdLevel simd_level_;
+		std::vector<char> buffer_;
+		size_t buffered_ = 0;
+		std::fstream out_;
+		uint64_t write_pos_ = 0;
+		size_t input_size_ = 0;
+		size_t output_size_ = 0;
+		size_t events_ = 0;
+		size_t dropped_events_ = 0;
+		bool append(const char* data, size_t size, std::error_code& ec);
+		bool flush(std::error_code& ec);
+		bool is_unchanged(const std::filesystem::path& file, std::error_code& ec);
+		bool copy_prefix(const std::filesystem::path& file, size_t size, std::error_code& ec);
+	};
+
+}
@@ -0,0 +1,249 @@
+#include "log_discovery.h"
+
+#include <ctime>
+#include <chrono>
+#include <algorithm>
+#include "compressed_file.h"
+
+namespace soldy {
+
+	static std::tm local_time(std::time_t time) {
+		std::tm tm{};
+#ifdef _WIN32
+		localtime_s(&tm, &time);
+#else
+		localtime_r(&time, &tm);
+#endif
+		return tm;
+	}
+
+	//Начало часа YYMMDDHH по местному времени (имена файлов 1С в местном времени)
+	static std::filesystem::file_time_type hour_to_file_time(const std::wstring& hour) {
+		auto num = [&hour](size_t pos) { return (hour[pos] - L'0') * 10 + (hour[pos + 1] - L'0'); };
+		std::tm tm{};
+		tm.tm_year = 100 + num(0);
+		tm.tm_mon = num(2) - 1;
+		tm.tm_mday = num(4);
+		tm.tm_hour = num(6);
+		tm.tm_isdst = -1;
+		auto sys_time = std::chrono::system_clock::from_time_t(std::mktime(&tm));
+		//clock_cast доступен не во всех стандартных библиотеках, пересчитываем через текущее время обоих часов
+		return std::filesystem::file_time_type::clock::now()
+			+ std::chrono::duration_cast<std::filesystem::file_time_type::duration>(sys_time - std::chrono::system_clock::now());
+	}
+
+	LogDiscovery::LogDiscovery(const std::filesystem::path& root, Filter filter, size_t thread_count)
+		: root_(root), filter_(std::move(filter)), thread_count_(thread_count ? thread_count : 1), files_(QUEUE_CAPACITY) {
+		active_hour_ = ActiveHour();
+
+		since_time_ = filter_.since.empty() ? std::filesystem::file_time_type::min() : hour_to_file_time(filter_.since);
+		until_time_ = filter_.until.empty() ? std::filesystem::file_time_type::max() : hour_to_file_time(filter_.until);
+	}
+
+	LogDiscovery::~LogDiscovery() {
+		stop();
+	}
+
+	bool LogDiscovery::Start(std::error_code& ec) {
+		if (!std::filesystem::exists(root_, ec)) {
+			if (!ec) ec = std::make_error_code(std::errc::no_such_file_or_directory);
+			return false;
+		}
+
+		if (!std::filesystem::is_directory(root_, ec)) {
+			if (!ec && std::filesystem::is_regular_file(root_, ec) && IsLogFile(root_)) {
+				files_.Push(root_);
+			}
+			files_.Close();
+			return !ec;
+		}
+
+		dirs_.push_back(root_);
+		running_threads_ = thread_count_;
+		for (size_t i = 0; i < thread_count_; ++i) {
+			threads_.emplace_back(&LogDiscovery::worker, this);
+		}
+		return true;
+	}
+
+	bool LogDiscovery::Next(std::filesystem::path& file) {
+		return files_.Pop(file);
+	}
+
+	std::vector<std::filesystem::path> LogDiscovery::Collect() {
+		std::vector<std::filesystem::path> files;
+		std::filesystem::path file;
+		while (Next(file)) {
+			files.push_back(file);
+		}
+		return files;
+	}
+
+	void LogDiscovery::worker() {
+		std::vector<std::filesystem::path> subdirs;
+		while (!stop_) {
+			std::filesystem::path dir;
+			{
+				std::unique_lock<std::mutex> lock(dirs_mutex_);
+				dirs_cv_.wait(lock, [this] { return stop_ || !dirs_.empty() || !active_dirs_; });
+				if (stop_ || dirs_.empty()) {
+					break;
+				}
+				dir = std::move(dirs_.front());
+				dirs_.pop_front();
+				++active_dirs_;
+			}
+
+			subdirs.clear();
+			scan_dir(dir, subdirs);
+
+			{
+				std::lock_guard<std::mutex> lock(dirs_mutex_);
+				for (auto& subdir : subdirs) {
+					dirs_.push_back(std::move(subdir));
+				}
+				--active_dirs_;
+			}
+			dirs_cv_.notify_all();
+		}
+
+		//Последний завершившийся поток закрывает очередь файлов
+		std::lock_guard<std::mutex> lock(dirs_mutex_);
+		dirs_cv_.notify_all();
+		if (!--running_threads_) {
+			files_.Close();
+		}
+	}
+
+	void LogDiscovery::scan_dir(const std::filesystem::path& dir, std::vector<std::filesystem::path>& subdirs) {
+		std::error_code ec;
+		std::filesystem::directory_iterator it(dir, std::filesystem::directory_options::skip_permission_denied, ec);
+		for (; !ec && it != std::filesystem::directory_iterator(); it.increment(ec)) {
+			const auto& entry = *it;
+			std::error_code entry_ec;
+			if (entry.is_directory(entry_ec) && !entry.is_symlink(entry_ec)) {
+				subdirs.push_back(entry.path());
+			}
+			else if (entry.is_regular_file(entry_ec) && IsLogFile(entry.path()) && accept(entry.path())) {
+				if (!files_.Push(entry.path())) {
+					return;
+				}
+			}
+		}
+	}
+
+	bool LogDiscovery::accept(const std::filesystem::path& file) {
+		const std::wstring hour = HourOf(file);
+		if (!filter_.include_active && hour == active_hour_) {
+			return false;
+		}
+
+		//Сжатый журнал рядом с несжатым того же часа (24010110.log.gz и 24010110.log) пропускается:
+		//результаты обоих имели бы одно имя, обрабатывается несжатый
+		const Codec codec = CodecFromPath(file);
+		if (codec != Codec::None) {
+			std::wstring name = file.filename().wstring();
+			name.resize(name.size() - CodecExtension(codec).size());
+			std::error_code ec;
+			if (std::filesystem::exists(file.parent_path() / (name + CodecExtension(Codec::None)), ec)) {
+				return false;
+			}
+		}
+
+		if (!filter_.since.empty() || !filter_.until.empty()) {
+			if (filter_.by == Filter::By::Name) {
+				//YYMMDDHH сравниваются как строки
+				if (hour.empty() || (!filter_.since.empty() && hour < filter_.since) || (!filter_.until.empty() && hour >= filter_.until)) {
+					return false;
+				}
+			}
+			else {
+				std::error_code ec;
+				auto mtime = std::filesystem::last_write_time(file, ec);
+				if (ec || mtime < since_time_ || mtime >= until_time_) {
+					return false;
+				}
+			}
+		}
+
+		if (!filter_.include.empty() || !filter_.exclude.empty()) {
+			const std::wstring relative = file.lexically_relative(root_).generic_wstring();
+			auto match = [&relative](const std::wstring& pattern) { return MatchGlob(pattern, relative); };
+			if (!filter_.include.empty() && std::none_of(filter_.include.begin(), filter_.include.end(), match)) {
+				return false;
+			}
+			if (std::any_of(filter_.exclude.begin(), filter_.exclude.end(), match)) {
+				return false;
+			}
+		}
+
+		return true;
+	}
+
+	void LogDiscovery::stop() {
+		{
+			std::lock_guard<std::mutex> lock(dirs_mutex_);
+			stop_ = true;
+		}
+		files_.Close();
+		dirs_cv_.notify_all();
+		for (auto& thread : threads_) {
+			if (thread.joinable()) {
+				thread.join();
+			}
+		}
+		threads_.clear();
+	}
+
+	std::wstring LogDiscovery::ActiveHour() {
+		std::tm now = local_time(std::time(nullptr));
+		wchar_t buf[16];
+		std::swprintf(buf, 16, L"%02d%02d%02d%02d", now.tm_year % 100, now.tm_mon + 1, now.tm_mday, now.tm_hour);
+		return buf;
+	}
+
+	bool LogDiscovery::IsLogFile(const std::filesystem::path& file) {
+		return file.extension() == ".log" || CodecFromPath(file) != Codec::None;
+	}
+
+	std::wstring LogDiscovery::HourOf(const std::filesystem::path& file) {
+		std::wstring name = file.filename().wstring();
+		const std::wstring extension = CodecExtension(CodecFromPath(file));
+		if (name.size() < extension.size() || name.compare(name.size() - extension.size(), extension.size(), extension) != 0) {
+			return L"";
+		}
+		name.resize(name.size() - extension.size());
+		return IsHour(name) ? name : L"";
+	}
+
+	bool LogDiscovery::IsHour(const std::wstring& value) {
+		return value.size() == 8 && std::all_of(value.begin(), value.end(), [](wchar_t c) { return c >= L'0' && c <= L'9'; });
+	}
+
+	bool LogDiscovery::MatchGlob(const std::wstring& pattern, const std::wstring& str) {
+		size_t p = 0, s = 0;
+		size_t star = std::wstring::npos, star_s = 0;
+		while (s < str.size()) {
+			if (p < pattern.size() && (pattern[p] == L'?' || pattern[p] == str[s])) {
+				++p;
+				++s;
+			}
+			else if (p < pattern.size() && pattern[p] == L'*') {
+				star = p++;
+				star_s = s;
+			}
+			else if (star != std::wstring::npos) {
+				p = star + 1;
+				s = ++star_s;
+			}
+			else {
+				return false;
+			}
+		}
+		while (p < pattern.size() && pattern[p] == L'*') {
+			++p;
+		}
+		return p == pattern.size();
+	}
+
+}
@@ -0,0 +1,79 @@
+#pragma once
+
+#include <filesystem>
+#include <string>
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <condition_variable>
+#include "blocking_queue.h"
+
+namespace soldy {
+
+	//Параллельный обход каталогов журналов. Найденные файлы сразу попадают в очередь,
+	//обработчики забирают их через Next(), не дожидаясь окончания обхода.
+	class LogDiscovery {
+	public:
+		struct Filter {
+			enum class By {
+				Name,
+				Mtime
+			};
+			//Фильтр по времени: по часу в имени файла YYMMDDHH или по времени изменения файла
+			By by = By::Name;
+			//Границы [since, until) в формате YYMMDDHH, пустая строка - без ограничения
+			std::wstring since;
+			std::wstring until;
+			//Шаблоны (* и ?) для пути относительно каталога обхода
+			std::vector<std::wstring> include;
+			std::vector<std::wstring> exclude;
+			//Обрабатывать файл текущего часа, в который еще пишет сервер 1С
+			bool include_active = false;
+		};
+
+		static constexpr size_t DEFAULT_THREADS = 4;
+		static constexpr size_t QUEUE_CAPACITY = 4096;
+
+		LogDiscovery(const std::filesystem::path& root, Filter filter, size_t thread_count = DEFAULT_THREADS);
+		~LogDiscovery();
+		LogDiscovery(const LogDiscovery&) = delete;
+		LogDiscovery& operator=(const LogDiscovery&) = delete;
+
+		bool Start(std::error_code& ec);
+		//Следующий найденный файл. false - обход завершен и очередь пуста
+		bool Next(std::filesystem::path& file);
+		//Дожидается окончания обхода и возвращает все файлы
+		std::vector<std::filesystem::path> Collect();
+
+		//Журналы: *.log, *.log.gz, *.log.zst
+		static bool IsLogFile(const std::filesystem::path& file);
+		//Час YYMMDDHH из имени файла журнала, пустая строка если имя другое
+		static std::wstring HourOf(const std::filesystem::path& file);
+		//Текущий час YYMMDDHH по местному времени: его файл сервер 1С еще пишет
+		static std::wstring ActiveHour();
+		static bool IsHour(const std::wstring& value);
+		static bool MatchGlob(const std::wstring& pattern, const std::wstring& str);
+	private:
+		std::filesystem::path root_;
+		Filter filter_;
+		size_t thread_count_;
+		std::wstring active_hour_;
+		std::filesystem::file_time_type since_time_;
+		std::filesystem::file_time_type until_time_;
+		std::vector<std::thread> threads_;
+		std::deque<std::filesystem::path> dirs_;
+		std::mutex dirs_mutex_;
+		std::condition_variable dirs_cv_;
+		size_t active_dirs_ = 0;
+		size_t running_threads_ = 0;
+		std::atomic<bool> stop_{ false };
+		BlockingQueue<std::filesystem::path> files_;
+		void worker();
+		void scan_dir(const std::filesystem::path& dir, std::vector<std::filesystem::path>& subdirs);
+		bool accept(const std::filesystem::path& file);
+		void stop();
+	};
+
+}
@@ -0,0 +1,128 @@
+#include "log_event.h"
+
+namespace soldy {
+
+	LogEvent::Header LogEvent::ParseHeader(const char* ch, size_t size, std::string_view& name, uint64_t& duration) {
+		size_t i = TIMESTAMP_SIZE;
+		if (size <= i) {
+			return Header::Incomplete;
+		}
+		if (ch[i++] != '-') {
+			return Header::Invalid;
+		}
+		duration = 0;
+		for (; i < size && ch[i] >= '0' && ch[i] <= '9'; ++i) {
+			duration = duration * 10 + static_cast<uint64_t>(ch[i] - '0');
+		}
+		if (i == size) {
+			return Header::Incomplete;
+		}
+		if (ch[i++] != ',') {
+			return Header::Invalid;
+		}
+		const size_t name_begin = i;
+		for (; i < size && ch[i] != ','; ++i) {
+			if (ch[i] == LF || ch[i] == CHANGE_LF) {
+				return Header::Invalid;
+			}
+		}
+		if (i == size) {
+			return Header::Incomplete;
+		}
+		if (i == name_begin) {
+			return Header::Invalid;
+		}
+		name = std::string_view(ch + name_begin, i - name_begin);
+		return Header::Parsed;
+	}
+
+#ifdef __linux__
+	__attribute__((target("avx2")))
+#endif
+	static const char* find_next_event_256(const char* ch, const char* end) {
+		const __m256i newline_mask = _mm256_set1_epi8(LogEvent::LF);
+		for (; ch + 32 <= end; ch += 32) {
+			__m256i block = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(ch));
+			uint32_t mask = _mm256_movemask_epi8(_mm256_cmpeq_epi8(block, newline_mask));
+			while (mask != 0) {
+				size_t pos = CTZ32(mask);
+				const char* next = ch + pos + 1;
+				if (next + 32 <= end) {
+					if (LogEvent::IsNewEvent256(next)) {
+						return next;
+					}
+				}
+				else if (next + LogEvent::TIMESTAMP_SIZE <= end) {
+					if (LogEvent::IsNewEvent(next)) {
+						return next;
+					}
+				}
+				else {
+					return nullptr;
+				}
+				mask &= mask - 1;
+			}
+		}
+		for (; ch + LogEvent::TIMESTAMP_SIZE < end; ++ch) {
+			if (*ch == LogEvent::LF && LogEvent::IsNewEvent(ch + 1)) {
+				return ch + 1;
+			}
+		}
+		return nullptr;
+	}
+
+#ifdef __linux__
+	__attribute__((target("avx512f,avx512bw")))
+#endif
+	static const char* find_next_event_512(const char* ch, const char* end) {
+		const __m512i newline_mask = _mm512_set1_epi8(LogEvent::LF);
+		for (; ch + 64 <= end; ch += 64) {
+			__m512i block = _mm512_loadu_si512(reinterpret_cast<const __m512i*>(ch));
+			uint64_t mask = _mm512_cmpeq_epi8_mask(block, newline_mask);
+			while (mask != 0) {
+				size_t pos = CTZ64(mask);
+				const char* next = ch + pos + 1;
+				if (next + 64 <= end) {
+					if (LogEvent::IsNewEvent512(next)) {
+						return next;
+					}
+				}
+				else if (next + LogEvent::TIMESTAMP_SIZE <= end) {
+					if (LogEvent::IsNewEvent(next)) {
+						return next;
+					}
+				}
+				else {
+					return nullptr;
+				}
+				mask &= mask - 1;
+			}
+		}
+		for (; ch + LogEvent::TIMESTAMP_SIZE < end; ++ch) {
+			if (*ch == LogEvent::LF && LogEvent::IsNewEvent(ch + 1)) {
+				return ch + 1;
+			}
+		}
+		return nullptr;
+	}
+
+	static const char* find_next_event_none(const char* ch, const char* end) {
+		for (; ch + LogEvent::TIMESTAMP_SIZE < end; ++ch) {
+			if (*ch == LogEvent::LF && LogEvent::IsNewEvent(ch + 1)) {
+				return ch + 1;
+			}
+		}
+		return nullptr;
+	}
+
+	const char* LogEvent::FindNextEvent(const char* begin, const char* end, SimdSupport::SimdLevel simd_level) {
+		if (simd_level == SimdSupport::SimdLevel::AVX512) {
+			return find_next_event_512(begin, end);
+		}
+		else if (simd_level == SimdSupport::SimdLevel::AVX2) {
+			return find_next_event_256(begin, end);
+		}
+		return find_next_event_none(begin, end);
+	}
+
+}
@@ -0,0 +1,167 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <string_view>
+#include <immintrin.h>
+#include "simd_support.h"
+
+#ifdef _WIN32
+#include <intrin.h>
+#define CTZ64 _tzcnt_u64
+#define CTZ32 _tzcnt_u32
+#else
+#define CTZ64 __builtin_ctzll
+#define CTZ32 __builtin_ctz
+#endif
+
+namespace soldy {
+
+	//Общие для всех режимов функции разбора событий технологического журнала 1С.
+	//Событие начинается с метки времени MM:SS.ffffff сразу после перевода строки (или с начала файла).
+	class LogEvent {
+	public:
+		static constexpr char CR = '\r';
+		static constexpr char LF = '\n';
+		static constexpr char CHANGE_CR = 0x01;
+		static constexpr char CHANGE_LF = 0x02;
+		//19:00.501005 - признак нового события 12 символов
+		static constexpr size_t TIMESTAMP_SIZE = 12;
+
+		enum class Header {
+			Parsed,
+			//Заголовок не уместился в переданные символы
+			Incomplete,
+			Invalid
+		};
+
+		static bool IsNewEvent(const char* ch);
+		static bool IsNewEvent256(const char* ch);
+		static bool IsNewEvent512(const char* ch);
+
+		//Ищет начало следующего события в [begin, end): позицию сразу после '\n', за которым идет метка времени.
+		//Перевод строки, после которого в диапазоне меньше TIMESTAMP_SIZE символов, не проверяется.
+		//Возвращает nullptr, если начало события не найдено.
+		static const char* FindNextEvent(const char* begin, const char* end, SimdSupport::SimdLevel simd_level);
+
+		//Метка времени MM:SS.ffffff в микросекундах от начала часа
+		static uint64_t Timestamp(const char* ch) {
+			auto d = [ch](size_t i) { return static_cast<uint64_t>(ch[i] - '0'); };
+			uint64_t minutes = d(0) * 10 + d(1);
+			uint64_t seconds = d(3) * 10 + d(4);
+			uint64_t micro = d(6) * 100000 + d(7) * 10000 + d(8) * 1000 + d(9) * 100 + d(10) * 10 + d(11);
+			return (minutes * 60 + seconds) * 1000000 + micro;
+		}
+
+		//Разбор заголовка "MM:SS.ffffff-<длительность>,<событие>," с начала события
+		static Header ParseHeader(const char* ch, size_t size, std::string_view& name, uint64_t& duration);
+
+		//Конец значения свойства (",Имя=значение"): запятая или конец строки, значение в кавычках ('...' или "...",
+		//кавычка внутри удваивается) - до закрывающей кавычки. Если значение не закончилось в [ch, end), возвращает end.
+		static const char* PropertyValueEnd(const char* ch, const char* end) {
+			if (ch < end && (*ch == '\'' || *ch == '"')) {
+				const char quote = *ch;
+				for (++ch; ch < end; ++ch) {
+					if (*ch == quote) {
+						if (ch + 1 < end && *(ch + 1) == quote) {
+							++ch;
+							continue;
+						}
+						return ch + 1;
+					}
+				}
+				return end;
+			}
+			while (ch < end && *ch != ',' && *ch != LF && *ch != CR && *ch != CHANGE_LF && *ch != CHANGE_CR) {
+				++ch;
+			}
+			return ch;
+		}
+
+		//Пропускает UTF-8 BOM в начале файла
+		static size_t BomSize(const char* ch, size_t size) {
+			return (size >= 3 && static_cast<unsigned char>(ch[0]) == 0xEF
+				&& static_cast<unsigned char>(ch[1]) == 0xBB && static_cast<unsigned char>(ch[2]) == 0xBF) ? 3 : 0;
+		}
+	};
+
+	inline bool LogEvent::IsNewEvent(const char* ch) {
+		return
+			*ch >= '0' && *ch <= '9'
+			&& *(ch + 1) >= '0' && *(ch + 1) <= '9'
+			&& *(ch + 2) == ':'
+			&& *(ch + 3) >= '0' && *(ch + 3) <= '9'
+			&& *(ch + 4) >= '0' && *(ch + 4) <= '9'
+			&& *(ch + 5) == '.'
+			&& *(ch + 6) >= '0' && *(ch + 6) <= '9'
+			&& *(ch + 7) >= '0' && *(ch + 7) <= '9'
+			&& *(ch + 8) >= '0' && *(ch + 8) <= '9'
+			&& *(ch + 9) >= '0' && *(ch + 9) <= '9'
+			&& *(ch + 10) >= '0' && *(ch + 10) <= '9'
+			&& *(ch + 11) >= '0' && *(ch + 11) <= '9';
+	}
+
+#ifdef __linux__
+	__attribute__((target("avx2")))
+#endif
+	inline bool LogEvent::IsNewEvent256(const char* ch) {
+		static const __m256i zero = _mm256_set1_epi8('0');
+		static const __m256i nine = _mm256_set1_epi8('9');
+		static const __m256i colon = _mm256_set1_epi8(':');
+		static const __m256i dot = _mm256_set1_epi8('.');
+		static const uint32_t pattern_mask =
+			(1U << 0) | (1U << 1) |   // \d\d
+			(1U << 3) | (1U << 4) |   // :\d\d
+			(1U << 6) | (1U << 7) | (1U << 8) |
+			(1U << 9) | (1U << 10) | (1U << 11);  // \.\d{6}
+
+		__m256i data = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(ch));
+
+		// Проверка цифр: data >= '0' && data <= '9'
+		__m256i ge_zero = _mm256_cmpeq_epi8(_mm256_max_epu8(data, zero), data); // data >= '0'
+		__m256i le_nine = _mm256_cmpeq_epi8(_mm256_min_epu8(data, nine), data); // data <= '9'
+		__m256i is_digit = _mm256_and_si256(ge_zero, le_nine);
+		uint32_t is_digit_mask = _mm256_movemask_epi8(is_digit);
+
+		if ((is_digit_mask & pattern_mask) != pattern_mask) {
+			return false;
+		}
+
+		// Проверка двоеточия и точки
+		__m256i is_colon = _mm256_cmpeq_epi8(data, colon);
+		__m256i is_dot = _mm256_cmpeq_epi8(data, dot);
+		uint32_t colon_mask = _mm256_movemask_epi8(is_colon);
+		uint32_t dot_mask = _mm256_movemask_epi8(is_dot);
+
+		return (colon_mask & (1U << 2)) && (dot_mask & (1U << 5));
+	}
+
+#ifdef __linux__
+	__attribute__((target("avx512f,avx512bw")))
+#endif
+	inline bool LogEvent::IsNewEvent512(const char* ch) {
+		static const __m512i zero = _mm512_set1_epi8('0');
+		static const __m512i nine = _mm512_set1_epi8('9');
+		static const __m512i colon = _mm512_set1_epi8(':');
+		static const __m512i dot = _mm512_set1_epi8('.');
+		static const __mmask64 pattern_mask =
+			(1ULL << 0) | (1ULL << 1) |   // \d\d
+			(1ULL << 3) | (1ULL << 4) |   // :\d\d
+			(1ULL << 6) | (1ULL << 7) | (1ULL << 8) |
+			(1ULL << 9) | (1ULL << 10) | (1ULL << 11);  // \.\d{6}
+
+		__m512i data = _mm512_loadu_si512(reinterpret_cast<const __m512i*>(ch));
+		__mmask64 is_digit_mask = _mm512_cmple_epu8_mask(data, nine) &
+			_mm512_cmpge_epu8_mask(data, zero);
+
+		if ((is_digit_mask & pattern_mask) != pattern_mask) {
+			return false;
+		}
+
+		__mmask64 colon_mask = _mm512_cmpeq_epi8_mask(data, colon);
+		__mmask64 dot_mask = _mm512_cmpeq_epi8_mask(data, dot);
+
+		return (colon_mask & (1ULL << 2)) && (dot_mask & (1ULL << 5));
+	}
+
+}
@@ -0,0 +1,221 @@
+#include "log_hash.h"
+
+#include <algorithm>
+#include <cstring>
+#include <cstdio>
+#include <fstream>
+#include <immintrin.h>
+
+namespace soldy {
+
+	namespace {
+		const uint64_t PRIME32_1 = 0x9E3779B1ULL;
+		const uint64_t PRIME64_1 = 0x9E3779B185EBCA87ULL;
+		const uint64_t PRIME64_2 = 0xC2B2AE3D27D4EB4FULL;
+		const uint64_t PRIME64_3 = 0x165667B19E3779F9ULL;
+		const uint64_t PRIME64_4 = 0x85EBCA77C2B2AE63ULL;
+		const uint64_t PRIME64_5 = 0x27D4EB2F165667C5ULL;
+
+		alignas(64) const uint64_t STRIPE_KEY[8] = {
+			0xBE4BA423396CFEB8ULL, 0x1CAD21F72C81017CULL, 0xDB979083E96DD4DEULL, 0x1F67B3B7A4A44072ULL,
+			0x78E5C0CC4EE679CBULL, 0x2172FFCC7DD05A82ULL, 0x8E2443F7744608B8ULL, 0x4C263A81E69035E0ULL
+		};
+		const uint64_t SCRAMBLE_KEY[8] = {
+			0xCB00C391BB52283CULL, 0xA32E531B8B65D088ULL, 0x4EF90DA297486471ULL, 0xD8ACDEA946EF1938ULL,
+			0x3F349CE33F76FAA8ULL, 0x1D4F0BC7C7BBDCF9ULL, 0x3159B4CD4BE0518AULL, 0x647378D9C97E9FC8ULL
+		};
+
+		inline uint64_t read64(const char* ch) {
+			uint64_t value;
+			std::memcpy(&value, ch, sizeof(value));
+			return value;
+		}
+
+		inline uint64_t rotl64(uint64_t value, int bits) {
+			return (value << bits) | (value >> (64 - bits));
+		}
+	}
+
+	LogHash::LogHash(SimdSupport::SimdLevel simd_level) : simd_level_(simd_level) {
+		for (size_t i = 0; i < 8; ++i) {
+			acc_[i] = PRIME64_1 * (i + 1);
+		}
+	}
+
+	void LogHash::Update(const char* data, size_t size) {
+		size_ += size;
+		if (buffered_) {
+			const size_t size_copy = (std::min)(size, STRIPE_SIZE - buffered_);
+			std::memcpy(buffer_ + buffered_, data, size_copy);
+			buffered_ += size_copy;
+			data += size_copy;
+			size -= size_copy;
+			if (buffered_ < STRIPE_SIZE) {
+				return;
+			}
+			consume(buffer_, 1);
+			buffered_ = 0;
+		}
+		const size_t stripes = size / STRIPE_SIZE;
+		consume(data, stripes);
+		buffered_ = size - stripes * STRIPE_SIZE;
+		std::memcpy(buffer_, data + stripes * STRIPE_SIZE, buffered_);
+	}
+
+	uint64_t LogHash::Digest() const {
+		uint64_t hash = size_ * PRIME64_1;
+		for (size_t i = 0; i < 8; ++i) {
+			uint64_t value = acc_[i] ^ STRIPE_KEY[i];
+			value ^= value >> 37;
+			value *= PRIME64_2;
+			hash ^= value;
+			hash = rotl64(hash, 27) * PRIME64_1 + PRIME64_4;
+		}
+		//Неполная полоса в конце данных
+		for (size_t i = 0; i < buffered_; ++i) {
+			hash ^= static_cast<uint8_t>(buffer_[i]) * PRIME64_5;
+			hash = rotl64(hash, 11) * PRIME64_1;
+		}
+		hash ^= hash >> 33;
+		hash *= PRIME64_2;
+		hash ^= hash >> 29;
+		hash *= PRIME64_3;
+		hash ^= hash >> 32;
+		return hash;
+	}
+
+	void LogHash::consume(const char* data, size_t stripes) {
+		//Перемешивание накопителей после каждого блока, граница блока считается от начала данных
+		while (stripes) {
+			const size_t count = (std::min)(stripes, STRIPES_PER_BLOCK - block_stripes_);
+			accumulate(data, count);
+			data += count * STRIPE_SIZE;
+			stripes -= count;
+			block_stripes_ += count;
+			if (block_stripes_ == STRIPES_PER_BLOCK) {
+				scramble();
+				block_stripes_ = 0;
+			}
+		}
+	}
+
+	void LogHash::accumulate(const char* data, size_t stripes) {
+		if (simd_level_ == SimdSupport::SimdLevel::AVX512) {
+			accumulate_512(data, stripes);
+		} else if (simd_level_ == SimdSupport::SimdLevel::AVX2) {
+			accumulate_256(data, stripes);
+		} else {
+			accumulate_none(data, stripes);
+		}
+	}
+
+#ifdef __linux__
+	__attribute__((target("avx512f,avx512bw")))
+#endif
+	void LogHash::accumulate_512(const char* data, size_t stripes) {
+		__m512i acc = _mm512_load_si512(reinterpret_cast<const __m512i*>(acc_));
+		const __m512i key = _mm512_load_si512(reinterpret_cast<const __m512i*>(STRIPE_KEY));
+		for (size_t i = 0; i < stripes; ++i, data += STRIPE_SIZE) {
+			__m512i block = _mm512_loadu_si512(reinterpret_cast<const __m512i*>(data));
+			__m512i block_key = _mm512_xor_si512(block, key);
+			__m512i product = _mm512_mul_epu32(block_key, _mm512_srli_epi64(block_key, 32));
+			__m512i swapped = _mm512_shuffle_epi32(block, _MM_PERM_BADC);
+			acc = _mm512_add_epi64(acc, _mm512_add_epi64(product, swapped));
+		}
+		_mm512_store_si512(reinterpret_cast<__m512i*>(acc_), acc);
+	}
+
+#ifdef __linux__
+	__attribute__((target("avx2")))
+#endif
+	void LogHash::accumulate_256(const char* data, size_t stripes) {
+		__m256i acc_lo = _mm256_load_si256(reinterpret_cast<const __m256i*>(acc_));
+		__m256i acc_hi = _mm256_load_si256(reinterpret_cast<const __m256i*>(acc_ + 4));
+		const __m256i key_lo = _mm256_load_si256(reinterpret_cast<const __m256i*>(STRIPE_KEY));
+		const __m256i key_hi = _mm256_load_si256(reinterpret_cast<const __m256i*>(STRIPE_KEY + 4));
+		for (size_t i = 0; i < stripes; ++i, data += STRIPE_SIZE) {
+			__m256i block_lo = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data));
+			__m256i block_hi = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + 32));
+			__m256i key_block_lo = _mm256_xor_si256(block_lo, key_lo);
+			__m256i key_block_hi = _mm256_xor_si256(block_hi, key_hi);
+			__m256i product_lo = _mm256_mul_epu32(key_block_lo, _mm256_srli_epi64(key_block_lo, 32));
+			__m256i product_hi = _mm256_mul_epu32(key_block_hi, _mm256_srli_epi64(key_block_hi, 32));
+			__m256i swapped_lo = _mm256_shuffle_epi32(block_lo, _MM_SHUFFLE(1, 0, 3, 2));
+			__m256i swapped_hi = _mm256_shuffle_epi32(block_hi, _MM_SHUFFLE(1, 0, 3, 2));
+			acc_lo = _mm256_add_epi64(acc_lo, _mm256_add_epi64(product_lo, swapped_lo));
+			acc_hi = _mm256_add_epi64(acc_hi, _mm256_add_epi64(product_hi, swapped_hi));
+		}
+		_mm256_store_si256(reinterpret_cast<__m256i*>(acc_), acc_lo);
+		_mm256_store_si256(reinterpret_cast<__m256i*>(acc_ + 4), acc_hi);
+	}
+
+	void LogHash::accumulate_none(const char* data, size_t stripes) {
+		for (size_t i = 0; i < stripes; ++i, data += STRIPE_SIZE) {
+			uint64_t block[8];
+			for (size_t j = 0; j < 8; ++j) {
+				block[j] = read64(data + j * 8);
+			}
+			for (size_t j = 0; j < 8; ++j) {
+				const uint64_t key_block = block[j] ^ STRIPE_KEY[j];
+				acc_[j] += (key_block & 0xFFFFFFFFULL) * (key_block >> 32) + block[j ^ 1];
+			}
+		}
+	}
+
+	void LogHash::scramble() {
+		for (size_t i = 0; i < 8; ++i) {
+			acc_[i] ^= acc_[i] >> 47;
+			acc_[i] ^= SCRAMBLE_KEY[i];
+			acc_[i] *= PRIME32_1;
+		}
+	}
+
+	std::filesystem::path LogHash::SidecarPath(const std::filesystem::path& file) {
+		std::filesystem::path sidecar = file;
+		sidecar += L".hash";
+		return sidecar;
+	}
+
+	bool LogHash::WriteSidecar(const std::filesystem::path& file, uint64_t digest, uint64_t size, std::error_code& ec) {
+		std::ofstream stream(SidecarPath(file), std::ios::trunc);
+		if (!stream) {
+			ec = std::make_error_code(std::errc::permission_denied);
+			return false;
+		}
+		char line[64];
+		std::snprintf(line, sizeof(line), "%016llx %llu\n", static_cast<unsigned long long>(digest), static_cast<unsigned long long>(size));
+		stream << line;
+		if (!stream.flush()) {
+			ec = std::make_error_code(std::errc::io_error);
+			return false;
+		}
+		return true;
+	}
+
+	bool LogHash::ReadSidecar(const std::filesystem::path& file, uint64_t& digest, uint64_t& size, std::error_code& ec) {
+		std::ifstream stream(SidecarPath(file));
+		if (!stream) {
+			ec = std::make_error_code(std::errc::no_such_file_or_directory);
+			return false;
+		}
+		unsigned long long digest_value = 0;
+		unsigned long long size_value = 0;
+		if (!(stream >> std::hex >> digest_value >> std::dec >> size_value)) {
+			ec = std::make_error_code(std::errc::invalid_argument);
+			return false;
+		}
+		digest = digest_value;
+		size = size_value;
+		return true;
+	}
+
+	std::wstring LogHash::ToHex(uint64_t value) {
+		static const wchar_t* digits = L"0123456789abcdef";
+		std::wstring hex(16, L'0');
+		for (size_t i = 0; i < 16; ++i) {
+			hex[15 - i] = digits[(value >> (i * 4)) & 0xF];
+		}
+		return hex;
+	}
+
+}
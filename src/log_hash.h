@@ -0,0 +1,45 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <filesystem>
+#include <string>
+#include <system_error>
+#include "simd_support.h"
+
+namespace soldy {
+
+	//Потоковый 64-битный хеш для проверки журналов. Данные обрабатываются полосами по 64 байта в 8 накопителях
+	//(схема XXH3: умножение 32x32->64 и перемешивание накопителей каждые 64 КБ), поэтому AVX512, AVX2 и
+	//скалярный вариант дают один и тот же результат, а результат не зависит от того, какими частями переданы данные.
+	class LogHash {
+	public:
+		static constexpr size_t STRIPE_SIZE = 64;
+		static constexpr size_t STRIPES_PER_BLOCK = 1024;
+
+		explicit LogHash(SimdSupport::SimdLevel simd_level);
+		void Update(const char* data, size_t size);
+		uint64_t Digest() const;
+		uint64_t Size() const noexcept { return size_; }
+
+		//Хеш, записанный при преобразовании, хранится рядом с журналом: <файл>.hash
+		static std::filesystem::path SidecarPath(const std::filesystem::path& file);
+		static bool WriteSidecar(const std::filesystem::path& file, uint64_t digest, uint64_t size, std::error_code& ec);
+		static bool ReadSidecar(const std::filesystem::path& file, uint64_t& digest, uint64_t& size, std::error_code& ec);
+		static std::wstring ToHex(uint64_t value);
+	private:
+		SimdSupport::SimdLevel simd_level_;
+		alignas(64) uint64_t acc_[8];
+		char buffer_[STRIPE_SIZE];
+		size_t buffered_ = 0;
+		size_t block_stripes_ = 0;
+		uint64_t size_ = 0;
+		void consume(const char* data, size_t stripes);
+		void accumulate(const char* data, size_t stripes);
+		void accumulate_512(const char* data, size_t stripes);
+		void accumulate_256(const char* data, size_t stripes);
+		void accumulate_none(const char* data, size_t stripes);
+		void scramble();
+	};
+
+}
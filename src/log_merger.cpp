@@ -0,0 +1,74 @@
+#include "log_merger.h"
+
+namespace soldy {
+
+	//Суммарный объем окон всех входных файлов; при сотнях файлов окно каждого уменьшается
+	static const size_t MERGE_WINDOWS_LIMIT = 1024ULL * 1024 * 1024;
+	static const size_t MERGE_MIN_WINDOW = 1024 * 1024;
+
+	LogMerger::LogMerger(SimdSupport::SimdLevel simd_level, size_t window_size)
+		: simd_level_(simd_level), window_size_(window_size) {
+	}
+
+	bool LogMerger::Merge(const std::vector<std::filesystem::path>& inputs, const std::filesystem::path& output, std::error_code& ec) {
+		event_count_ = 0;
+		input_size_ = 0;
+		output_size_ = 0;
+
+		const size_t window_size = inputs.empty() ? window_size_
+			: (std::max)(MERGE_MIN_WINDOW, (std::min)(window_size_, MERGE_WINDOWS_LIMIT / inputs.size()));
+
+		std::vector<std::unique_ptr<EventReader>> readers;
+		readers.reserve(inputs.size());
+		for (const auto& input : inputs) {
+			auto reader = std::make_unique<EventReader>(simd_level_, window_size);
+			if (!reader->Open(input, ec)) {
+				return false;
+			}
+			input_size_ += reader->FileSize();
+			readers.push_back(std::move(reader));
+		}
+
+		//(метка времени, номер файла): при равном времени порядок определяется порядком входных файлов
+		using HeapItem = std::pair<uint64_t, size_t>;
+		std::priority_queue<HeapItem, std::vector<HeapItem>, std::greater<HeapItem>> heap;
+		for (size_t i = 0; i < readers.size(); ++i) {
+			if (readers[i]->Next(ec)) {
+				heap.emplace(readers[i]->Timestamp(), i);
+			}
+			else if (ec) {
+				return false;
+			}
+		}
+
+		EventWriter writer;
+		if (!writer.Open(output, ec)) {
+			return false;
+		}
+
+		while (!heap.empty()) {
+			size_t i = heap.top().second;
+			heap.pop();
+
+			EventReader& reader = *readers[i];
+			if (!writer.WriteFlat(reader.Data(), reader.Size(), ec)) {
+				return false;
+			}
+			++event_count_;
+
+			if (reader.Next(ec)) {
+				heap.emplace(reader.Timestamp(), i);
+			}
+			else if (ec) {
+				return false;
+			}
+		}
+
+		if (!writer.Close(ec)) {
+			return false;
+		}
+		output_size_ = writer.Size();
+		return true;
+	}
+
+}
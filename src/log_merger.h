@@ -0,0 +1,30 @@
+#pragma once
+
+#include <filesystem>
+#include <vector>
+#include <memory>
+#include <queue>
+#include "simd_support.h"
+#include "event_reader.h"
+#include "event_writer.h"
+
+namespace soldy {
+
+	//Слияние журналов разных процессов за один час в один поток событий, упорядоченный по времени MM:SS.ffffff.
+	//Каждый файл читается окнами через EventReader, текущие события всех файлов хранятся в куче.
+	class LogMerger {
+	private:
+		SimdSupport::SimdLevel simd_level_;
+		size_t window_size_;
+		size_t event_count_ = 0;
+		size_t input_size_ = 0;
+		size_t output_size_ = 0;
+	public:
+		LogMerger(SimdSupport::SimdLevel simd_level, size_t window_size = EventReader::DEFAULT_WINDOW_SIZE);
+		bool Merge(const std::vector<std::filesystem::path>& inputs, const std::filesystem::path& output, std::error_code& ec);
+		size_t EventCount() const noexcept { return event_count_; }
+		size_t InputSize() const noexcept { return input_size_; }
+		size_t OutputSize() const noexcept { return output_size_; }
+	};
+
+}
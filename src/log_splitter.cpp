@@ -0,0 +1,156 @@
+#include "log_splitter.h"
+
+#include <algorithm>
+#include <fstream>
+#include "mapped_file.h"
+#include "log_event.h"
+
+#ifdef __linux__
+#include <cerrno>
+#endif
+
+namespace soldy {
+
+	namespace {
+		const char BOM[] = { '\xEF', '\xBB', '\xBF' };
+	}
+
+	LogSplitter::LogSplitter(SimdSupport::SimdLevel simd_level) : simd_level_(simd_level) {
+	}
+
+	bool LogSplitter::Plan(const std::filesystem::path& file, size_t part_size, std::vector<size_t>& bounds, bool& has_bom, std::error_code& ec) {
+		bounds.assign(1, 0);
+		has_bom = false;
+		MappedFile mapped_file;
+		if (!mapped_file.OpenSequential(file, ec, MappedFile::Access::ReadOnly)) {
+			return false;
+		}
+		const size_t file_size = mapped_file.FileSize();
+		if (file_size) {
+			if (!mapped_file.MapRegion(0, (std::min)(sizeof(BOM), file_size), ec)) {
+				return false;
+			}
+			has_bom = LogEvent::BomSize(static_cast<const char*>(mapped_file.Data()), mapped_file.MapSize()) != 0;
+			mapped_file.Unmap(false);
+		}
+
+		while (bounds.back() + part_size < file_size) {
+			//Начало события в from - это перевод строки в from - 1 и метка времени за ним
+			const size_t from = bounds.back() + part_size - 1;
+			size_t window = SEARCH_WINDOW;
+			size_t found = file_size;
+			while (true) {
+				const size_t size = (std::min)(window, file_size - from);
+				if (!mapped_file.MapRegion(from, size, ec)) {
+					return false;
+				}
+				const char* data = static_cast<const char*>(mapped_file.Data());
+				const char* next = LogEvent::FindNextEvent(data, data + size, simd_level_);
+				mapped_file.Unmap(false);
+				if (next) {
+					found = from + (next - data);
+					break;
+				}
+				if (from + size == file_size) {
+					break;
+				}
+				//Событие длиннее окна
+				window *= 2;
+			}
+			if (found == file_size) {
+				break;
+			}
+			bounds.push_back(found);
+		}
+		bounds.push_back(file_size);
+		return true;
+	}
+
+	bool LogSplitter::CopyRange(const std::filesystem::path& file, size_t begin, size_t end, const std::filesystem::path& output,
+		bool add_bom, size_t& kernel_copied, std::error_code& ec) {
+		kernel_copied = 0;
+#ifdef __linux__
+		if (!copy_kernel(file, begin, end, output, add_bom, kernel_copied, ec)) {
+			return false;
+		}
+		if (begin + kernel_copied == end) {
+			return true;
+		}
+		//Файловая система не поддерживает копирование внутри ядра: дописываем остаток через буфер
+		return copy_buffered(file, begin + kernel_copied, end, output, true, false, ec);
+#else
+		return copy_buffered(file, begin, end, output, false, add_bom, ec);
+#endif
+	}
+
+#ifdef __linux__
+	bool LogSplitter::copy_kernel(const std::filesystem::path& file, size_t begin, size_t end, const std::filesystem::path& output,
+		bool add_bom, size_t& copied, std::error_code& ec) {
+		copied = 0;
+		int in_fd = ::open(file.c_str(), O_RDONLY);
+		if (in_fd == -1) {
+			ec = std::error_code(errno, std::system_category());
+			return false;
+		}
+		int out_fd = ::open(output.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+		if (out_fd == -1) {
+			ec = std::error_code(errno, std::system_category());
+			::close(in_fd);
+			return false;
+		}
+		bool is_ok = !add_bom || ::write(out_fd, BOM, sizeof(BOM)) == static_cast<ssize_t>(sizeof(BOM));
+		if (!is_ok) {
+			ec = std::error_code(errno, std::system_category());
+		}
+		loff_t in_offset = static_cast<loff_t>(begin);
+		while (is_ok && begin + copied < end) {
+			ssize_t size = ::copy_file_range(in_fd, &in_offset, out_fd, nullptr, end - begin - copied, 0);
+			if (size > 0) {
+				copied += static_cast<size_t>(size);
+				continue;
+			}
+			//0 - файл стал короче плана, остальные ошибки - копирование внутри ядра недоступно
+			if (size == 0 || !(errno == EXDEV || errno == ENOSYS || errno == EOPNOTSUPP || errno == EINVAL)) {
+				ec = size == 0 ? std::make_error_code(std::errc::io_error) : std::error_code(errno, std::system_category());
+				is_ok = false;
+			}
+			break;
+		}
+		::close(in_fd);
+		if (::close(out_fd) == -1 && is_ok) {
+			ec = std::error_code(errno, std::system_category());
+			is_ok = false;
+		}
+		return is_ok;
+	}
+#endif
+
+	bool LogSplitter::copy_buffered(const std::filesystem::path& file, size_t begin, size_t end, const std::filesystem::path& output,
+		bool is_append, bool add_bom, std::error_code& ec) {
+		std::ifstream in(file, std::ios::binary);
+		std::ofstream out(output, std::ios::binary | (is_append ? std::ios::app : std::ios::trunc));
+		if (!in || !out) {
+			ec = std::make_error_code(std::errc::permission_denied);
+			return false;
+		}
+		if (add_bom) {
+			out.write(BOM, sizeof(BOM));
+		}
+		in.seekg(static_cast<std::streamoff>(begin));
+		std::vector<char> buffer((std::min)(BUFFER_SIZE, end - begin));
+		while (begin < end) {
+			const size_t size = (std::min)(buffer.size(), end - begin);
+			if (!in.read(buffer.data(), static_cast<std::streamsize>(size)) || !out.write(buffer.data(), static_cast<std::streamsize>(size))) {
+				ec = std::make_error_code(std::errc::io_error);
+				return false;
+			}
+			begin += size;
+		}
+		if (!out.flush()) {
+			ec = std::make_error_code(std::errc::io_error);
+			return false;
+		}
+		return true;
+	}
+
+}
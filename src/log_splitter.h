@@ -0,0 +1,36 @@
+#pragma once
+
+#include <filesystem>
+#include <vector>
+#include <system_error>
+#include "simd_support.h"
+
+namespace soldy {
+
+	//Разделение большого журнала на части примерно заданного размера точно по началам событий.
+	//Границы ищутся в небольших окнах проекции около k * part_size, файл целиком не читается.
+	//Части копируются внутри ядра (copy_file_range), где это поддерживается: данные не проходят через процесс,
+	//на NFS 4.2 копирование выполняет сервер.
+	class LogSplitter {
+	public:
+		static constexpr size_t SEARCH_WINDOW = 1024 * 1024;
+		static constexpr size_t BUFFER_SIZE = 4 * 1024 * 1024;
+
+		explicit LogSplitter(SimdSupport::SimdLevel simd_level);
+
+		//Границы частей: 0, начала первых событий не раньше предыдущей границы + part_size, размер файла.
+		//has_bom - файл начинается с BOM, его получает каждая часть
+		bool Plan(const std::filesystem::path& file, size_t part_size, std::vector<size_t>& bounds, bool& has_bom, std::error_code& ec);
+		//Копирует [begin, end) файла в новый файл output, add_bom - сначала записывается BOM.
+		//kernel_copied - сколько скопировано внутри ядра, остальное скопировано через буфер
+		static bool CopyRange(const std::filesystem::path& file, size_t begin, size_t end, const std::filesystem::path& output,
+			bool add_bom, size_t& kernel_copied, std::error_code& ec);
+	private:
+		SimdSupport::SimdLevel simd_level_;
+		static bool copy_kernel(const std::filesystem::path& file, size_t begin, size_t end, const std::filesystem::path& output,
+			bool add_bom, size_t& copied, std::error_code& ec);
+		static bool copy_buffered(const std::filesystem::path& file, size_t begin, size_t end, const std::filesystem::path& output,
+			bool is_append, bool add_bom, std::error_code& ec);
+	};
+
+}
@@ -0,0 +1,192 @@
+#include "log_verifier.h"
+
+#include <algorithm>
+#include <cstring>
+#include <immintrin.h>
+#include "log_event.h"
+#include "mapped_file.h"
+#include "compressed_file.h"
+
+namespace soldy {
+
+	LogVerifier::LogVerifier(SimdSupport::SimdLevel simd_level)
+		: simd_level_(simd_level), hash_(simd_level), buffer_(BUFFER_SIZE) {
+	}
+
+	bool LogVerifier::Verify(const std::filesystem::path& file, std::error_code& ec) {
+		bool is_verified = CodecFromPath(file) == Codec::None ? verify_mapped(file, ec) : verify_compressed(file, ec);
+		if (!is_verified) {
+			return false;
+		}
+		flush(true);
+		return true;
+	}
+
+	bool LogVerifier::verify_mapped(const std::filesystem::path& file, std::error_code& ec) {
+		MappedFile mapped_file;
+		if (!mapped_file.OpenSequential(file, ec, MappedFile::Access::ReadOnly)) {
+			return false;
+		}
+		const size_t file_size = mapped_file.FileSize();
+		for (size_t offset = 0; offset < file_size; offset += WINDOW_SIZE) {
+			const size_t size = (std::min)(WINDOW_SIZE, file_size - offset);
+			if (!mapped_file.MapRegion(offset, size, ec)) {
+				return false;
+			}
+			mapped_file.Prefetch(offset + size, WINDOW_SIZE);
+			update(static_cast<const char*>(mapped_file.Data()), size);
+			mapped_file.Unmap();
+		}
+		return true;
+	}
+
+	bool LogVerifier::verify_compressed(const std::filesystem::path& file, std::error_code& ec) {
+		CompressedReader reader;
+		if (!reader.Open(file, CodecFromPath(file), ec)) {
+			return false;
+		}
+		std::vector<char> chunk(4 * BUFFER_SIZE);
+		while (size_t size = reader.Read(chunk.data(), chunk.size(), ec)) {
+			update(chunk.data(), size);
+		}
+		return !ec;
+	}
+
+	void LogVerifier::update(const char* data, size_t size) {
+		while (size) {
+			const size_t size_copy = (std::min)(size, BUFFER_SIZE - buffered_);
+			std::memcpy(buffer_.data() + buffered_, data, size_copy);
+			buffered_ += size_copy;
+			data += size_copy;
+			size -= size_copy;
+			if (buffered_ == BUFFER_SIZE) {
+				flush(false);
+			}
+		}
+	}
+
+	void LogVerifier::flush(bool is_last) {
+		//Для 0x02 нужна метка времени после него, поэтому последние символы ждут следующей порции
+		const size_t lookahead = is_last ? 0 : LogEvent::TIMESTAMP_SIZE;
+		if (buffered_ <= lookahead) {
+			return;
+		}
+		const size_t count = buffered_ - lookahead;
+		char* ch = buffer_.data();
+
+		size_t processed = 0;
+		if (simd_level_ == SimdSupport::SimdLevel::AVX512) {
+			processed = unflat_view_512(ch, count, buffered_);
+		} else if (simd_level_ == SimdSupport::SimdLevel::AVX2) {
+			processed = unflat_view_256(ch, count, buffered_);
+		}
+		unflat_view_none(ch, processed, count, buffered_);
+
+		hash_.Update(ch, count);
+		std::memmove(ch, ch + count, buffered_ - count);
+		buffered_ -= count;
+		offset_ += count;
+	}
+
+	//Развернутое представление: 0x02 -> '\n', 0x01 перед 0x02 -> '\r' (как unflat_chank_*).
+	//Следующий символ читается до изменения, поэтому замену можно делать на месте.
+#ifdef __linux__
+	__attribute__((target("avx512f,avx512bw")))
+#endif
+	size_t LogVerifier::unflat_view_512(char* ch, size_t count, size_t avail) {
+		const __m512i change_lf = _mm512_set1_epi8(LogEvent::CHANGE_LF);
+		const __m512i change_cr = _mm512_set1_epi8(LogEvent::CHANGE_CR);
+		const __m512i lf = _mm512_set1_epi8(LogEvent::LF);
+		const __m512i cr = _mm512_set1_epi8(LogEvent::CR);
+		size_t i = 0;
+		for (; i + 64 <= count && i + 65 <= avail; i += 64) {
+			__m512i block = _mm512_loadu_si512(reinterpret_cast<const __m512i*>(ch + i));
+			__m512i next = _mm512_loadu_si512(reinterpret_cast<const __m512i*>(ch + i + 1));
+			uint64_t lf_mask = _mm512_cmpeq_epi8_mask(block, change_lf);
+			uint64_t cr_mask = _mm512_cmpeq_epi8_mask(block, change_cr);
+			if (!(lf_mask | cr_mask)) {
+				continue;
+			}
+			uint64_t next_lf_mask = _mm512_cmpeq_epi8_mask(next, change_lf);
+			uint64_t raw_cr_mask = cr_mask & ~next_lf_mask;
+			while (raw_cr_mask) {
+				add_raw(offset_ + i + CTZ64(raw_cr_mask));
+				++raw_cr_;
+				raw_cr_mask &= raw_cr_mask - 1;
+			}
+			for (uint64_t mask = lf_mask; mask; mask &= mask - 1) {
+				check_raw_lf(ch, i + CTZ64(mask), avail);
+			}
+			block = _mm512_mask_blend_epi8(lf_mask, block, lf);
+			block = _mm512_mask_blend_epi8(cr_mask & next_lf_mask, block, cr);
+			_mm512_storeu_si512(reinterpret_cast<__m512i*>(ch + i), block);
+		}
+		return i;
+	}
+
+#ifdef __linux__
+	__attribute__((target("avx2")))
+#endif
+	size_t LogVerifier::unflat_view_256(char* ch, size_t count, size_t avail) {
+		const __m256i change_lf = _mm256_set1_epi8(LogEvent::CHANGE_LF);
+		const __m256i change_cr = _mm256_set1_epi8(LogEvent::CHANGE_CR);
+		const __m256i lf = _mm256_set1_epi8(LogEvent::LF);
+		const __m256i cr = _mm256_set1_epi8(LogEvent::CR);
+		size_t i = 0;
+		for (; i + 32 <= count && i + 33 <= avail; i += 32) {
+			__m256i block = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(ch + i));
+			__m256i next = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(ch + i + 1));
+			__m256i is_lf = _mm256_cmpeq_epi8(block, change_lf);
+			__m256i is_cr = _mm256_cmpeq_epi8(block, change_cr);
+			uint32_t lf_mask = _mm256_movemask_epi8(is_lf);
+			uint32_t cr_mask = _mm256_movemask_epi8(is_cr);
+			if (!(lf_mask | cr_mask)) {
+				continue;
+			}
+			__m256i is_next_lf = _mm256_cmpeq_epi8(next, change_lf);
+			uint32_t raw_cr_mask = cr_mask & ~static_cast<uint32_t>(_mm256_movemask_epi8(is_next_lf));
+			while (raw_cr_mask) {
+				add_raw(offset_ + i + CTZ32(raw_cr_mask));
+				++raw_cr_;
+				raw_cr_mask &= raw_cr_mask - 1;
+			}
+			for (uint32_t mask = lf_mask; mask; mask &= mask - 1) {
+				check_raw_lf(ch, i + CTZ32(mask), avail);
+			}
+			block = _mm256_blendv_epi8(block, lf, is_lf);
+			block = _mm256_blendv_epi8(block, cr, _mm256_and_si256(is_cr, is_next_lf));
+			_mm256_storeu_si256(reinterpret_cast<__m256i*>(ch + i), block);
+		}
+		return i;
+	}
+
+	void LogVerifier::unflat_view_none(char* ch, size_t begin, size_t count, size_t avail) {
+		for (size_t i = begin; i < count; ++i) {
+			if (ch[i] == LogEvent::CHANGE_LF) {
+				check_raw_lf(ch, i, avail);
+				ch[i] = LogEvent::LF;
+			}
+			else if (ch[i] == LogEvent::CHANGE_CR) {
+				if (i + 1 < avail && ch[i + 1] == LogEvent::CHANGE_LF) {
+					ch[i] = LogEvent::CR;
+				}
+				else {
+					add_raw(offset_ + i);
+					++raw_cr_;
+				}
+			}
+		}
+	}
+
+	void LogVerifier::check_raw_lf(const char* ch, size_t pos, size_t avail) {
+		if (pos + 1 + LogEvent::TIMESTAMP_SIZE <= avail && LogEvent::IsNewEvent(ch + pos + 1)) {
+			add_raw(offset_ + pos);
+			++raw_lf_;
+		}
+	}
+
+	void LogVerifier::add_raw(uint64_t offset) {
+		first_raw_offset_ = (std::min)(first_raw_offset_, offset);
+	}
+
+}
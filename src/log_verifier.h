@@ -0,0 +1,54 @@
+#pragma once
+
+#include <filesystem>
+#include <vector>
+#include <limits>
+#include <system_error>
+#include "simd_support.h"
+#include "log_hash.h"
+
+namespace soldy {
+
+	//Проверка обратимости преобразования без изменения файла: за один проход по flat-журналу считается
+	//хеш его развернутого (unflat) представления, который сравнивается с хешем исходного файла.
+	//Попутно считаются "сырые" символы 0x01/0x02, которых не могло быть в результате преобразования.
+	class LogVerifier {
+	public:
+		static constexpr size_t BUFFER_SIZE = 256 * 1024;
+		static constexpr size_t WINDOW_SIZE = 64 * 1024 * 1024;
+		static constexpr uint64_t NO_OFFSET = (std::numeric_limits<uint64_t>::max)();
+
+		explicit LogVerifier(SimdSupport::SimdLevel simd_level);
+		LogVerifier(const LogVerifier&) = delete;
+		LogVerifier& operator=(const LogVerifier&) = delete;
+
+		//Читает файл (сжатый - с распаковкой) и считает хеш развернутого представления
+		bool Verify(const std::filesystem::path& file, std::error_code& ec);
+		uint64_t Digest() const { return hash_.Digest(); }
+		uint64_t Size() const noexcept { return hash_.Size(); }
+		//0x01 не перед 0x02: такой символ был в исходном файле
+		size_t RawCr() const noexcept { return raw_cr_; }
+		//0x02 перед меткой времени: преобразование не заменяет перевод строки перед началом события
+		size_t RawLf() const noexcept { return raw_lf_; }
+		uint64_t FirstRawOffset() const noexcept { return first_raw_offset_; }
+	private:
+		SimdSupport::SimdLevel simd_level_;
+		LogHash hash_;
+		std::vector<char> buffer_;
+		size_t buffered_ = 0;
+		uint64_t offset_ = 0;
+		size_t raw_cr_ = 0;
+		size_t raw_lf_ = 0;
+		uint64_t first_raw_offset_ = NO_OFFSET;
+		bool verify_mapped(const std::filesystem::path& file, std::error_code& ec);
+		bool verify_compressed(const std::filesystem::path& file, std::error_code& ec);
+		void update(const char* data, size_t size);
+		void flush(bool is_last);
+		size_t unflat_view_512(char* ch, size_t count, size_t avail);
+		size_t unflat_view_256(char* ch, size_t count, size_t avail);
+		void unflat_view_none(char* ch, size_t begin, size_t count, size_t avail);
+		void check_raw_lf(const char* ch, size_t pos, size_t avail);
+		void add_raw(uint64_t offset);
+	};
+
+}
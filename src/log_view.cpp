@@ -0,0 +1,168 @@
+#include "log_view.h"
+
+#include <algorithm>
+#include "log_event.h"
+#include "event_index.h"
+#include "event_reader.h"
+
+namespace soldy {
+
+	LogView::LogView(SimdSupport::SimdLevel simd_level) : simd_level_(simd_level) {
+	}
+
+	bool LogView::Open(const std::filesystem::path& file, std::error_code& ec) {
+		file_ = file;
+		return mapped_file_.OpenSequential(file, ec, MappedFile::Access::ReadOnly);
+	}
+
+	void LogView::Decode(const char* data, size_t size, std::string& out) {
+		out.assign(data, size);
+		for (size_t i = 0; i < size; ++i) {
+			if (out[i] == LogEvent::CHANGE_LF) {
+				out[i] = LogEvent::LF;
+			}
+			else if (out[i] == LogEvent::CHANGE_CR && i + 1 < size && out[i + 1] == LogEvent::CHANGE_LF) {
+				out[i] = LogEvent::CR;
+			}
+		}
+	}
+
+	bool LogView::ReadNumbers(std::vector<std::pair<uint64_t, uint64_t>> ranges, const Visitor& visit, std::error_code& ec) {
+		std::sort(ranges.begin(), ranges.end());
+		std::vector<std::pair<uint64_t, uint64_t>> merged;
+		for (const auto& range : ranges) {
+			if (!merged.empty() && range.first <= merged.back().second + 1) {
+				merged.back().second = (std::max)(merged.back().second, range.second);
+			}
+			else {
+				merged.push_back(range);
+			}
+		}
+		if (merged.empty()) {
+			return true;
+		}
+		//Нет индекса или он построен для другого размера файла - номера считаются просмотром
+		std::vector<uint64_t> probe;
+		uint64_t total = 0;
+		if (EventIndex::LoadRange(file_, 0, 0, probe, total, ec)) {
+			return read_indexed(merged, visit, ec);
+		}
+		ec.clear();
+		return read_scanned(merged, visit, ec);
+	}
+
+	bool LogView::read_indexed(const std::vector<std::pair<uint64_t, uint64_t>>& ranges, const Visitor& visit, std::error_code& ec) {
+		const uint64_t file_size = mapped_file_.FileSize();
+		std::vector<uint64_t> offsets;
+		for (const auto& [first, last] : ranges) {
+			//Смещение следующего события - конец последнего из диапазона
+			uint64_t total = 0;
+			if (!EventIndex::LoadRange(file_, first, last - first + 2, offsets, total, ec)) {
+				return false;
+			}
+			for (size_t i = 0; i < offsets.size() && first + i <= last; ++i) {
+				const uint64_t end = i + 1 < offsets.size() ? offsets[i + 1] : file_size;
+				bool is_continue = true;
+				if (!read_range(offsets[i], end, first + i, visit, is_continue, ec)) {
+					return false;
+				}
+				if (!is_continue) {
+					return false;
+				}
+			}
+			if (last + 1 >= total) {
+				break;
+			}
+		}
+		return true;
+	}
+
+	bool LogView::read_scanned(const std::vector<std::pair<uint64_t, uint64_t>>& ranges, const Visitor& visit, std::error_code& ec) {
+		EventReader reader(simd_level_);
+		if (!reader.Open(file_, ec)) {
+			return false;
+		}
+		size_t range = 0;
+		for (uint64_t number = 0; range < ranges.size() && reader.Next(ec); ++number) {
+			if (number < ranges[range].first) {
+				continue;
+			}
+			Decode(reader.Data(), reader.Size(), text_);
+			if (!visit(number, reader.Offset(), text_)) {
+				return false;
+			}
+			if (number == ranges[range].second) {
+				++range;
+			}
+		}
+		return !ec;
+	}
+
+	bool LogView::ReadAt(uint64_t offset, const Visitor& visit, std::error_code& ec) {
+		const uint64_t file_size = mapped_file_.FileSize();
+		if (offset + LogEvent::TIMESTAMP_SIZE > file_size) {
+			ec = std::make_error_code(std::errc::invalid_argument);
+			return false;
+		}
+		//Начало события: метка времени в начале файла (после BOM) или после перевода строки
+		const uint64_t begin = offset <= 3 ? 0 : offset - 1;
+		size_t window = WINDOW_SIZE;
+		while (true) {
+			const size_t size = static_cast<size_t>((std::min)(static_cast<uint64_t>(window), file_size - begin));
+			if (!mapped_file_.MapRegion(begin, size, ec)) {
+				return false;
+			}
+			const char* data = static_cast<const char*>(mapped_file_.Data());
+			const char* event = data + (offset - begin);
+			const bool is_start = LogEvent::IsNewEvent(event) && (offset == 0 || event[-1] == LogEvent::LF
+				|| (offset == 3 && LogEvent::BomSize(data, size)));
+			if (!is_start) {
+				mapped_file_.Unmap(false);
+				ec = std::make_error_code(std::errc::invalid_argument);
+				return false;
+			}
+			const char* next = LogEvent::FindNextEvent(event, data + size, simd_level_);
+			if (next || begin + size == file_size) {
+				const size_t event_size = next ? static_cast<size_t>(next - event) : static_cast<size_t>(size - (offset - begin));
+				Decode(event, event_size, text_);
+				mapped_file_.Unmap(false);
+				return visit(NO_NUMBER, offset, text_);
+			}
+			mapped_file_.Unmap(false);
+			//Событие длиннее окна
+			window *= 2;
+		}
+	}
+
+	bool LogView::ReadMatching(const TraceQuery& query, const Visitor& visit, std::error_code& ec) {
+		EventReader reader(simd_level_);
+		if (!reader.Open(file_, ec)) {
+			return false;
+		}
+		for (uint64_t number = 0; reader.Next(ec); ++number) {
+			if (!query.Match(reader.Data(), reader.Size())) {
+				continue;
+			}
+			Decode(reader.Data(), reader.Size(), text_);
+			if (!visit(number, reader.Offset(), text_)) {
+				return false;
+			}
+		}
+		return !ec;
+	}
+
+	bool LogView::read_range(uint64_t begin, uint64_t end, uint64_t number, const Visitor& visit, bool& is_continue, std::error_code& ec) {
+		if (begin >= end || end > mapped_file_.FileSize()) {
+			ec = std::make_error_code(std::errc::invalid_argument);
+			return false;
+		}
+		if (!mapped_file_.MapRegion(begin, static_cast<size_t>(end - begin), ec)) {
+			return false;
+		}
+		Decode(static_cast<const char*>(mapped_file_.Data()), static_cast<size_t>(end - begin), text_);
+		mapped_file_.Unmap(false);
+		is_continue = visit(number, begin, text_);
+		return true;
+	}
+
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <limits>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+#include <system_error>
+#include "mapped_file.h"
+#include "simd_support.h"
+#include "trace_query.h"
+
+namespace soldy {
+
+	//Просмотр отдельных событий flat-журнала в исходном виде без unflat всего файла: файл открывается только
+	//для чтения, 0x02/0x01 заменяются на LF/CR лишь в выдаваемых событиях. Стоимость зависит от показанных байтов:
+	//событие по смещению и по номеру с индексом <файл>.idx читается напрямую, без индекса номера считаются
+	//одним проходом чтения до последнего нужного события.
+	class LogView {
+	public:
+		//number - номер события от 0 (NO_NUMBER - не известен), offset - смещение в файле, text - исходный вид.
+		//Visitor вернул false - просмотр прекращается, Read* возвращают false без ec
+		using Visitor = std::function<bool(uint64_t number, uint64_t offset, std::string_view text)>;
+		static constexpr uint64_t NO_NUMBER = (std::numeric_limits<uint64_t>::max)();
+		static constexpr size_t WINDOW_SIZE = 64 * 1024;
+
+		explicit LogView(SimdSupport::SimdLevel simd_level);
+		LogView(const LogView&) = delete;
+		LogView& operator=(const LogView&) = delete;
+
+		bool Open(const std::filesystem::path& file, std::error_code& ec);
+		//События с номерами из диапазонов [first, last]
+		bool ReadNumbers(std::vector<std::pair<uint64_t, uint64_t>> ranges, const Visitor& visit, std::error_code& ec);
+		//Событие, начинающееся в offset (смещение из индекса, трассировки, сообщения об ошибке)
+		bool ReadAt(uint64_t offset, const Visitor& visit, std::error_code& ec);
+		//События, подходящие под запрос (просмотр всего файла, но только для чтения)
+		bool ReadMatching(const TraceQuery& query, const Visitor& visit, std::error_code& ec);
+		//Обратное преобразование события: 0x02 -> LF, 0x01 перед 0x02 -> CR
+		static void Decode(const char* data, size_t size, std::string& out);
+	private:
+		std::filesystem::path file_;
+		SimdSupport::SimdLevel simd_level_;
+		MappedFile mapped_file_;
+		std::string text_;
+		bool read_range(uint64_t begin, uint64_t end, uint64_t number, const Visitor& visit, bool& is_continue, std::error_code& ec);
+		bool read_indexed(const std::vector<std::pair<uint64_t, uint64_t>>& ranges, const Visitor& visit, std::error_code& ec);
+		bool read_scanned(const std::vector<std::pair<uint64_t, uint64_t>>& ranges, const Visitor& visit, std::error_code& ec);
+	};
+
+}
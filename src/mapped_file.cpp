@@ -1,9 +1,13 @@
 #include "mapped_file.h"
 
+#include <cstdint>
+
 namespace soldy {
 
-	bool MappedFile::OpenSequential(const std::filesystem::path& file_path, std::error_code& ec) {
+	bool MappedFile::OpenSequential(const std::filesystem::path& file_path, std::error_code& ec, Access access) {
 		close();
+		access_ = access;
+		const bool read_only = (access_ == Access::ReadOnly);
 
 		if (!std::filesystem::exists(file_path, ec)) {
 			if (!ec) ec = std::make_error_code(std::errc::no_such_file_or_directory);
@@ -15,7 +19,8 @@ namespace soldy {
 
 #ifdef _WIN32
 		//file_handle_ = CreateFileW(file_path.c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
-		file_handle_ = CreateFileW(file_path.c_str(), GENERIC_READ | GENERIC_WRITE, 0, nullptr, OPEN_EXISTING,
+		file_handle_ = CreateFileW(file_path.c_str(), read_only ? GENERIC_READ : GENERIC_READ | GENERIC_WRITE,
+			read_only ? FILE_SHARE_READ | FILE_SHARE_WRITE : 0, nullptr, OPEN_EXISTING,
 			FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
 
 		if (file_handle_ == INVALID_HANDLE_VALUE) {
@@ -25,7 +30,7 @@ namespace soldy {
 			return false;
 		}
 
-		file_mapping_handle_ = CreateFileMapping(file_handle_, nullptr, PAGE_READWRITE, 0, 0, nullptr);
+		file_mapping_handle_ = CreateFileMapping(file_handle_, nullptr, read_only ? PAGE_READONLY : PAGE_READWRITE, 0, 0, nullptr);
 		if (!file_mapping_handle_) {
 			ec = std::error_code(GetLastError(), std::system_category());
 			CloseHandle(file_handle_);
@@ -40,7 +45,7 @@ namespace soldy {
 			page_size_ = sys_info.dwAllocationGranularity;
 		}
 #else
-		fd_ = ::open(file_path.c_str(), O_RDWR);
+		fd_ = ::open(file_path.c_str(), read_only ? O_RDONLY : O_RDWR);
 		if (fd_ == -1) {
 			ec = std::error_code(errno, std::system_category());
 			return false;
@@ -64,11 +69,12 @@ namespace soldy {
 		size_t aligned_offset = offset & ~(page_size_ - 1);
 		cur_mapping_offset_delta_ = offset - aligned_offset;
 		offset -= cur_mapping_offset_delta_;
+		cur_mapping_file_offset_ = offset;
 
 #ifdef _WIN32
 		cur_mapping_ = MapViewOfFile(
 			file_mapping_handle_,
-			FILE_MAP_WRITE,
+			access_ == Access::ReadOnly ? FILE_MAP_READ : FILE_MAP_WRITE,
 			static_cast<DWORD>(offset >> 32),
 			static_cast<DWORD>(offset & 0xFFFFFFFF),
 			size + cur_mapping_offset_delta_
@@ -80,7 +86,8 @@ namespace soldy {
 			return false;
 		}
 #else
-		cur_mapping_ = mmap(nullptr, size + cur_mapping_offset_delta_, PROT_WRITE, MAP_SHARED, fd_, offset);
+		cur_mapping_ = mmap(nullptr, size + cur_mapping_offset_delta_,
+			access_ == Access::ReadOnly ? PROT_READ : PROT_WRITE, MAP_SHARED, fd_, offset);
 		if (cur_mapping_ == MAP_FAILED) {
 			cur_mapping_offset_delta_ = 0;
 			cur_mapping_size_ = 0;
@@ -93,18 +100,60 @@ namespace soldy {
 		return true;
 	}
 
-	void MappedFile::unmap_current_region() {
+	void MappedFile::Prefetch(size_t offset, size_t size) noexcept {
+		if (offset >= file_size_ || !size) {
+			return;
+		}
+		size = (std::min)(size, file_size_ - offset);
+#ifdef _WIN32
+		//Для непроецированного диапазона в Windows нет аналога, достаточно FILE_FLAG_SEQUENTIAL_SCAN
+#else
+		posix_fadvise(fd_, static_cast<off_t>(offset), static_cast<off_t>(size), POSIX_FADV_WILLNEED);
+#endif
+	}
+
+	void MappedFile::Flush(size_t offset, size_t size) noexcept {
+		if (!cur_mapping_ || access_ != Access::ReadWrite || offset >= cur_mapping_size_) {
+			return;
+		}
+		size = (std::min)(size, cur_mapping_size_ - offset);
+		char* begin = static_cast<char*>(cur_mapping_) + offset;
+#ifdef _WIN32
+		FlushViewOfFile(begin, size);
+#else
+		//msync требует адрес, выровненный по странице
+		char* aligned = reinterpret_cast<char*>(reinterpret_cast<uintptr_t>(begin) & ~(static_cast<uintptr_t>(page_size_) - 1));
+		msync(aligned, size + (begin - aligned), MS_SYNC);
+#endif
+	}
+
+	void MappedFile::unmap_current_region(bool is_modified) {
 		if (cur_mapping_) {
+			char* base = static_cast<char*>(cur_mapping_) - cur_mapping_offset_delta_;
+			const size_t size = cur_mapping_size_ + cur_mapping_offset_delta_;
 #ifdef _WIN32
-			FlushViewOfFile(static_cast<char*>(cur_mapping_) - cur_mapping_offset_delta_, cur_mapping_size_ + cur_mapping_offset_delta_);
-			UnmapViewOfFile(static_cast<char*>(cur_mapping_) - cur_mapping_offset_delta_);
+			if (access_ == Access::ReadWrite && is_modified) {
+				FlushViewOfFile(base, size);
+			}
+			//Управлять файловым кэшем Windows без прав администратора нельзя, страницы уходят из рабочего набора при UnmapViewOfFile
+			UnmapViewOfFile(base);
 #else
-			msync(static_cast<char*>(cur_mapping_) - cur_mapping_offset_delta_, cur_mapping_size_ + cur_mapping_offset_delta_, MS_SYNC);
-			munmap(static_cast<char*>(cur_mapping_) - cur_mapping_offset_delta_, cur_mapping_size_ + cur_mapping_offset_delta_);
+			if (access_ == Access::ReadWrite && is_modified) {
+				msync(base, size, MS_SYNC);
+			}
+			if (drop_cache_) {
+				madvise(base, size, MADV_DONTNEED);
+			}
+			munmap(base, size);
+			if (drop_cache_) {
+				//После MS_SYNC страницы чистые и могут быть выгружены из кэша
+				posix_fadvise(fd_, static_cast<off_t>(cur_mapping_file_offset_), static_cast<off_t>(size), POSIX_FADV_DONTNEED);
+			}
 #endif
 			cur_mapping_ = nullptr;
 			cur_mapping_size_ = 0;
 			cur_mapping_offset_delta_ = 0;
+			cur_mapping_file_offset_ = 0;
 		}
 	}
 
@@ -2,6 +2,7 @@
 
 #include <filesystem>
 #include <stdexcept>
+#include <algorithm>
 
 #ifdef _WIN32
 #include <windows.h>
@@ -15,6 +16,11 @@
 namespace soldy {
 
 	class MappedFile {
+	public:
+		enum class Access {
+			ReadWrite,
+			ReadOnly
+		};
 	private:
 #ifdef _WIN32
 		HANDLE file_handle_ = nullptr;
@@ -25,9 +31,12 @@ namespace soldy {
 		void* cur_mapping_ = nullptr;
 		size_t cur_mapping_size_ = 0;
 		size_t cur_mapping_offset_delta_ = 0;
+		size_t cur_mapping_file_offset_ = 0;
 		size_t file_size_ = 0;
 		size_t page_size_ = 0;
-		void unmap_current_region();
+		Access access_ = Access::ReadWrite;
+		bool drop_cache_ = false;
+		void unmap_current_region(bool is_modified = true);
 		void close();
 	public:
 		MappedFile() = default;
@@ -37,8 +46,16 @@ namespace soldy {
 		MappedFile(MappedFile&& other) = delete;
 		MappedFile& operator=(MappedFile&& other) = delete;
 
-		bool OpenSequential(const std::filesystem::path& file_path, std::error_code& ec);
+		bool OpenSequential(const std::filesystem::path& file_path, std::error_code& ec, Access access = Access::ReadWrite);
 		bool MapRegion(size_t offset, size_t size, std::error_code& ec);
+		//Подсказка ОС заранее прочитать диапазон файла в кэш (упреждающее чтение следующего окна)
+		void Prefetch(size_t offset, size_t size) noexcept;
+		//Сбрасывает на диск изменения части текущего региона (offset от Data()), чтобы запись шла равномерно, а не при Unmap
+		void Flush(size_t offset, size_t size) noexcept;
+		//Сбрасывает изменения на диск и освобождает текущий регион. is_modified = false - регион не менялся, сброс не нужен
+		void Unmap(bool is_modified = true) { unmap_current_region(is_modified); }
+		//Выгружать страницы региона из кэша ОС после записи, чтобы не вытеснять рабочие данные сервера 1С/СУБД
+		void SetDropCache(bool drop_cache) noexcept { drop_cache_ = drop_cache; }
 		void* Data() const noexcept { return cur_mapping_; }
 		size_t MapSize() const noexcept { return cur_mapping_size_; }
 		size_t FileSize() const noexcept { return file_size_; }
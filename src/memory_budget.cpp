@@ -0,0 +1,58 @@
+#include "memory_budget.h"
+
+#include <algorithm>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <unistd.h>
+#endif
+
+namespace soldy {
+
+	void MemoryBudget::Acquire(size_t size) {
+		std::unique_lock<std::mutex> lock(mutex_);
+		released_.wait(lock, [this, size] { return used_ + size <= capacity_ || !used_; });
+		used_ += size;
+	}
+
+	void MemoryBudget::Release(size_t size) {
+		{
+			std::lock_guard<std::mutex> lock(mutex_);
+			used_ -= (std::min)(size, used_);
+		}
+		released_.notify_all();
+	}
+
+	size_t MemoryBudget::PhysicalMemory() {
+#ifdef _WIN32
+		MEMORYSTATUSEX status{};
+		status.dwLength = sizeof(status);
+		if (GlobalMemoryStatusEx(&status)) {
+			return static_cast<size_t>(status.ullTotalPhys);
+		}
+		return 0;
+#else
+		long pages = sysconf(_SC_PHYS_PAGES);
+		long page_size = sysconf(_SC_PAGE_SIZE);
+		return (pages > 0 && page_size > 0) ? static_cast<size_t>(pages) * static_cast<size_t>(page_size) : 0;
+#endif
+	}
+
+	size_t MemoryBudget::DefaultCapacity() {
+		size_t memory = PhysicalMemory();
+		return memory ? (std::max)(memory / 4, MIN_REGION_SIZE) : MAX_REGION_SIZE;
+	}
+
+	size_t MemoryBudget::AutoRegionSize(size_t capacity, size_t thread_count, size_t file_size) {
+		static const size_t MB = 1024 * 1024;
+		size_t region = capacity / (thread_count ? thread_count : 1);
+		region = (std::min)((std::max)(region, MIN_REGION_SIZE), MAX_REGION_SIZE);
+		//Нижняя граница не поднимает регион выше самого бюджета
+		region = (std::min)(region, capacity);
+		if (file_size) {
+			region = (std::min)(region, (file_size + MB - 1) / MB * MB);
+		}
+		return (std::max)(region / MB * MB, MB);
+	}
+
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <cstddef>
+#include <mutex>
+#include <condition_variable>
+
+namespace soldy {
+
+	//Общий для всех потоков лимит на объем одновременно спроецированных в память регионов файлов.
+	//Поток, которому не хватает бюджета, ждет, пока другие потоки не освободят свои регионы.
+	class MemoryBudget {
+	private:
+		size_t capacity_;
+		size_t used_ = 0;
+		std::mutex mutex_;
+		std::condition_variable released_;
+	public:
+		//Освобождает захваченный объем при выходе из области видимости
+		class Lease {
+		private:
+			MemoryBudget* budget_;
+			size_t size_;
+		public:
+			Lease(MemoryBudget* budget, size_t size) : budget_(budget), size_(size) {
+				if (budget_) budget_->Acquire(size_);
+			}
+			~Lease() {
+				if (budget_) budget_->Release(size_);
+			}
+			Lease(const Lease&) = delete;
+			Lease& operator=(const Lease&) = delete;
+		};
+
+		static constexpr size_t MIN_REGION_SIZE = 64ULL * 1024 * 1024;
+		static constexpr size_t MAX_REGION_SIZE = 4ULL * 1024 * 1024 * 1024;
+
+		explicit MemoryBudget(size_t capacity) : capacity_(capacity) {}
+		MemoryBudget(const MemoryBudget&) = delete;
+		MemoryBudget& operator=(const MemoryBudget&) = delete;
+
+		//Запрос больше всего бюджета ждет, пока бюджет не освободится полностью
+		void Acquire(size_t size);
+		void Release(size_t size);
+		size_t Capacity() const noexcept { return capacity_; }
+
+		static size_t PhysicalMemory();
+		//Бюджет по умолчанию - четверть оперативной памяти
+		static size_t DefaultCapacity();
+		//Размер региона проецирования: бюджет делится между потоками, кратно 1 МБ.
+		//Не больше всего бюджета и размера файла (file_size == 0 - размер файла неизвестен)
+		static size_t AutoRegionSize(size_t capacity, size_t thread_count, size_t file_size = 0);
+	};
+
+}
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <filesystem>
+#include <system_error>
+
+namespace soldy {
+
+	//Потребитель данных, подключаемый к проходу FlatLog::ProcessData (FlatLog::AddConsumer): преобразование,
+	//индекс, счетчики и т.п. получают один и тот же спроецированный регион, и N результатов стоят одного чтения файла.
+	//Части передаются по порядку от начала файла, в потоке, который обрабатывает файл.
+	class RegionConsumer {
+	public:
+		struct Slice {
+			//Данные уже преобразованы (в режиме dry-run - исходные)
+			const char* data;
+			size_t size;
+			//Доступно для чтения от data (не меньше size): за концом части не меньше одного блока SIMD,
+			//за концом диапазона ProcessRange - до LOOKAHEAD символов
+			size_t avail;
+			//Смещение data от начала файла
+			size_t offset;
+			//Бит i (слово i / 64, бит i % 64): в data[i] начинается событие. Найдено ядром SIMD за тот же проход.
+			const uint64_t* event_starts;
+
+			bool IsEventStart(size_t i) const noexcept { return (event_starts[i >> 6] >> (i & 63)) & 1; }
+		};
+
+		static constexpr size_t LOOKAHEAD = 4096;
+
+		virtual ~RegionConsumer() = default;
+		virtual void Begin(const std::filesystem::path&, size_t) {}
+		virtual void Consume(const Slice& slice) = 0;
+		virtual bool End(std::error_code&) { return true; }
+	};
+
+}
@@ -0,0 +1,142 @@
+#include "result_cache.h"
+
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <random>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/stat.h>
+#endif
+
+namespace soldy {
+
+	namespace {
+		const char MAGIC[8] = { 'F', 'L', 'A', 'T', 'R', 'C', 'H', '1' };
+
+		uint64_t fnv1a(uint64_t hash, const void* data, size_t size) {
+			const unsigned char* ch = static_cast<const unsigned char*>(data);
+			for (size_t i = 0; i < size; ++i) {
+				hash = (hash ^ ch[i]) * 0x100000001B3ULL;
+			}
+			return hash;
+		}
+	}
+
+	ResultCache::ResultCache(const std::filesystem::path& dir) : dir_(dir) {
+	}
+
+	bool ResultCache::KeyOf(const std::filesystem::path& file, FileKey& key, std::error_code& ec) {
+#ifdef _WIN32
+		HANDLE handle = CreateFileW(file.c_str(), FILE_READ_ATTRIBUTES, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+			nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+		if (handle == INVALID_HANDLE_VALUE) {
+			ec = std::error_code(GetLastError(), std::system_category());
+			return false;
+		}
+		BY_HANDLE_FILE_INFORMATION info;
+		const bool is_ok = GetFileInformationByHandle(handle, &info);
+		if (!is_ok) {
+			ec = std::error_code(GetLastError(), std::system_category());
+		}
+		CloseHandle(handle);
+		if (!is_ok) {
+			return false;
+		}
+		key.device = info.dwVolumeSerialNumber;
+		key.inode = (static_cast<uint64_t>(info.nFileIndexHigh) << 32) | info.nFileIndexLow;
+		key.size = (static_cast<uint64_t>(info.nFileSizeHigh) << 32) | info.nFileSizeLow;
+		key.mtime = (static_cast<uint64_t>(info.ftLastWriteTime.dwHighDateTime) << 32) | info.ftLastWriteTime.dwLowDateTime;
+#else
+		struct stat st;
+		if (::stat(file.c_str(), &st) != 0) {
+			ec = std::error_code(errno, std::system_category());
+			return false;
+		}
+		key.device = st.st_dev;
+		key.inode = st.st_ino;
+		key.size = st.st_size;
+		key.mtime = static_cast<uint64_t>(st.st_mtim.tv_sec) * 1000000000ULL + st.st_mtim.tv_nsec;
+#endif
+		return true;
+	}
+
+	std::filesystem::path ResultCache::entry_path(const FileKey& key, std::string_view signature) const {
+		uint64_t hash = 0xCBF29CE484222325ULL;
+		hash = fnv1a(hash, &key.device, sizeof(key.device));
+		hash = fnv1a(hash, &key.inode, sizeof(key.inode));
+		hash = fnv1a(hash, signature.data(), signature.size());
+		char name[32];
+		std::snprintf(name, sizeof(name), "%016llx.rc", static_cast<unsigned long long>(hash));
+		return dir_ / name;
+	}
+
+	bool ResultCache::Load(const FileKey& key, std::string_view signature, std::string& payload) const {
+		std::ifstream stream(entry_path(key, signature), std::ios::binary);
+		if (!stream) {
+			return false;
+		}
+		char magic[sizeof(MAGIC)];
+		FileKey entry_key;
+		uint64_t signature_size = 0;
+		stream.read(magic, sizeof(magic));
+		stream.read(reinterpret_cast<char*>(&entry_key), sizeof(entry_key));
+		stream.read(reinterpret_cast<char*>(&signature_size), sizeof(signature_size));
+		if (!stream || std::memcmp(magic, MAGIC, sizeof(MAGIC)) != 0 || !(entry_key == key) || signature_size != signature.size()) {
+			return false;
+		}
+		std::string entry_signature(signature_size, '\0');
+		uint64_t payload_size = 0;
+		stream.read(entry_signature.data(), signature_size);
+		stream.read(reinterpret_cast<char*>(&payload_size), sizeof(payload_size));
+		//Совпадение хеша имени не гарантирует совпадения сигнатуры
+		if (!stream || entry_signature != signature || payload_size > key.size + 1024 * 1024) {
+			return false;
+		}
+		payload.resize(payload_size);
+		stream.read(payload.data(), payload_size);
+		return static_cast<bool>(stream);
+	}
+
+	bool ResultCache::Store(const FileKey& key, std::string_view signature, std::string_view payload, std::error_code& ec) const {
+		std::filesystem::create_directories(dir_, ec);
+		if (ec) {
+			return false;
+		}
+		const std::filesystem::path path = entry_path(key, signature);
+		std::filesystem::path temp_path = path;
+		temp_path += L"." + std::to_wstring(std::random_device()()) + L".tmp";
+		{
+			std::ofstream stream(temp_path, std::ios::binary | std::ios::trunc);
+			if (!stream) {
+				ec = std::make_error_code(std::errc::permission_denied);
+				return false;
+			}
+			const uint64_t signature_size = signature.size();
+			const uint64_t payload_size = payload.size();
+			stream.write(MAGIC, sizeof(MAGIC));
+			stream.write(reinterpret_cast<const char*>(&key), sizeof(key));
+			stream.write(reinterpret_cast<const char*>(&signature_size), sizeof(signature_size));
+			stream.write(signature.data(), signature.size());
+			stream.write(reinterpret_cast<const char*>(&payload_size), sizeof(payload_size));
+			stream.write(payload.data(), payload.size());
+			if (!stream.flush()) {
+				ec = std::make_error_code(std::errc::io_error);
+				stream.close();
+				std::filesystem::remove(temp_path, ec);
+				ec = std::make_error_code(std::errc::io_error);
+				return false;
+			}
+		}
+		std::filesystem::rename(temp_path, path, ec);
+		if (ec) {
+			std::error_code remove_ec;
+			std::filesystem::remove(temp_path, remove_ec);
+			return false;
+		}
+		return true;
+	}
+
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <string_view>
+#include <system_error>
+
+namespace soldy {
+
+	//Постоянный кэш результатов анализа по файлам (--cache): повторный запрос по закрытым часовым файлам
+	//берет готовый результат и читает только новые и измененные файлы.
+	//Запись кэша - <каталог>/<хеш устройства, inode и сигнатуры запроса>.rc, в ней хранятся размер и время изменения
+	//файла: запись измененного файла не подходит и перезаписывается новой.
+	class ResultCache {
+	public:
+		//Идентичность файла: устройство, inode (в Windows - серийный номер тома и индекс файла), размер, время изменения
+		struct FileKey {
+			uint64_t device = 0;
+			uint64_t inode = 0;
+			uint64_t size = 0;
+			uint64_t mtime = 0;
+
+			bool operator==(const FileKey& other) const noexcept {
+				return device == other.device && inode == other.inode && size == other.size && mtime == other.mtime;
+			}
+		};
+
+		explicit ResultCache(const std::filesystem::path& dir);
+
+		static bool KeyOf(const std::filesystem::path& file, FileKey& key, std::error_code& ec);
+		//false - записи нет или она устарела
+		bool Load(const FileKey& key, std::string_view signature, std::string& payload) const;
+		//Запись через временный файл и переименование: параллельный читатель не увидит неполную запись
+		bool Store(const FileKey& key, std::string_view signature, std::string_view payload, std::error_code& ec) const;
+	private:
+		std::filesystem::path dir_;
+		std::filesystem::path entry_path(const FileKey& key, std::string_view signature) const;
+	};
+
+}
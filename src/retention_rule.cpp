@@ -0,0 +1,49 @@
+#include "retention_rule.h"
+
+#include <algorithm>
+#include <limits>
+#include "log_event.h"
+
+namespace soldy {
+
+	bool RetentionRule::Parse(const std::wstring& value, RetentionRule& rule) {
+		rule.min_duration_.clear();
+		size_t begin = 0;
+		while (begin <= value.size()) {
+			size_t end = value.find(L',', begin);
+			if (end == std::wstring::npos) {
+				end = value.size();
+			}
+			const std::wstring item = value.substr(begin, end - begin);
+			const size_t less = item.find(L'<');
+			const std::wstring name = item.substr(0, less);
+			if (name.empty() || !std::all_of(name.begin(), name.end(),
+				[](wchar_t c) { return (c >= L'A' && c <= L'Z') || (c >= L'a' && c <= L'z') || (c >= L'0' && c <= L'9') || c == L'_'; })) {
+				return false;
+			}
+			uint64_t min_duration = (std::numeric_limits<uint64_t>::max)();
+			if (less != std::wstring::npos) {
+				const std::wstring duration = item.substr(less + 1);
+				if (duration.empty() || duration.size() > 18
+					|| !std::all_of(duration.begin(), duration.end(), [](wchar_t c) { return c >= L'0' && c <= L'9'; })) {
+					return false;
+				}
+				min_duration = std::stoull(duration);
+			}
+			rule.min_duration_[std::string(name.begin(), name.end())] = min_duration;
+			begin = end + 1;
+		}
+		return !rule.min_duration_.empty();
+	}
+
+	bool RetentionRule::IsDropped(const char* event, size_t size) const {
+		std::string_view name;
+		uint64_t duration = 0;
+		if (LogEvent::ParseHeader(event, size, name, duration) != LogEvent::Header::Parsed) {
+			return false;
+		}
+		auto it = min_duration_.find(name);
+		return it != min_duration_.end() && duration < it->second;
+	}
+
+}
@@ -0,0 +1,24 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <map>
+#include <string>
+#include <string_view>
+
+namespace soldy {
+
+	//Правило хранения для режима compact, список через запятую: "SCALL" - событие удаляется всегда,
+	//"CALL<1000" - удаляется, если длительность меньше 1000. Остальные события (и события с неразобранным
+	//заголовком) сохраняются.
+	class RetentionRule {
+	public:
+		static bool Parse(const std::wstring& value, RetentionRule& rule);
+		bool IsDropped(const char* event, size_t size) const;
+		bool Empty() const noexcept { return min_duration_.empty(); }
+	private:
+		//Событие -> минимальная сохраняемая длительность
+		std::map<std::string, uint64_t, std::less<>> min_duration_;
+	};
+
+}
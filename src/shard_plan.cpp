@@ -0,0 +1,151 @@
+#include "shard_plan.h"
+
+#include <algorithm>
+#include <numeric>
+#include <fstream>
+#include "log_event.h"
+#include "compressed_file.h"
+
+namespace soldy {
+
+	ShardPlan::ShardPlan(size_t index, size_t count, size_t split_size)
+		: index_(index), count_(count), split_size_((std::max)(split_size, RANGE_ALIGNMENT)) {
+	}
+
+	bool ShardPlan::Parse(const std::wstring& value, size_t& index, size_t& count) {
+		size_t pos = value.find(L'/');
+		if (pos == std::wstring::npos || pos == 0 || pos + 1 == value.size() || value.size() > 12) {
+			return false;
+		}
+		auto is_digit = [](wchar_t c) { return c >= L'0' && c <= L'9'; };
+		if (!std::all_of(value.begin(), value.begin() + pos, is_digit) || !std::all_of(value.begin() + pos + 1, value.end(), is_digit)) {
+			return false;
+		}
+		index = static_cast<size_t>(std::stoull(value.substr(0, pos)));
+		count = static_cast<size_t>(std::stoull(value.substr(pos + 1)));
+		return index >= 1 && index <= count;
+	}
+
+	std::vector<size_t> ShardPlan::Balance(const std::vector<Item>& items, size_t count) {
+		std::vector<size_t> order(items.size());
+		std::iota(order.begin(), order.end(), 0);
+		std::sort(order.begin(), order.end(), [&items](size_t a, size_t b) {
+			if (items[a].size != items[b].size) {
+				return items[a].size > items[b].size;
+			}
+			return items[a].key < items[b].key;
+		});
+
+		std::vector<size_t> owners(items.size(), 0);
+		std::vector<size_t> loads(count ? count : 1, 0);
+		for (size_t i : order) {
+			size_t shard = std::min_element(loads.begin(), loads.end()) - loads.begin();
+			owners[i] = shard;
+			loads[shard] += items[i].size;
+		}
+		return owners;
+	}
+
+	size_t ShardPlan::FindBoundary(const std::filesystem::path& file, size_t offset, size_t file_size, std::error_code& ec) {
+		std::ifstream stream(file, std::ios::binary);
+		if (!stream) {
+			ec = std::make_error_code(std::errc::no_such_file_or_directory);
+			return file_size;
+		}
+		size_t pos = (std::max)((offset + RANGE_ALIGNMENT - 1) / RANGE_ALIGNMENT * RANGE_ALIGNMENT, RANGE_ALIGNMENT);
+		for (; pos < file_size; pos += RANGE_ALIGNMENT) {
+			char pair[2];
+			stream.seekg(static_cast<std::streamoff>(pos - 1));
+			if (!stream.read(pair, 2)) {
+				ec = std::make_error_code(std::errc::io_error);
+				return file_size;
+			}
+			//Перевод строки на границе меняет и предыдущий символ, он был бы в чужой части
+			bool is_cr = pair[0] == LogEvent::CR || pair[0] == LogEvent::CHANGE_CR;
+			bool is_lf = pair[1] == LogEvent::LF || pair[1] == LogEvent::CHANGE_LF;
+			if (!(is_cr && is_lf)) {
+				return pos;
+			}
+		}
+		return file_size;
+	}
+
+	std::vector<ShardPlan::FileRange> ShardPlan::Assign(const std::vector<std::filesystem::path>& files, const std::filesystem::path& root, std::error_code& ec) const {
+		std::vector<FileRange> ranges;
+		std::vector<Item> items;
+		std::vector<FileRange> selected;
+
+		for (const auto& file : files) {
+			std::filesystem::path relative = std::filesystem::is_directory(root) ? file.lexically_relative(root) : file.filename();
+			std::wstring key = relative.generic_wstring();
+
+			Codec codec = CodecFromPath(file);
+			if (codec != Codec::None) {
+				key.resize(key.size() - CodecExtension(codec).size());
+				if (hash(key) % count_ == index_ - 1) {
+					selected.push_back({ file, 0, 0 });
+				}
+				continue;
+			}
+
+			std::error_code size_ec;
+			const size_t file_size = static_cast<size_t>(std::filesystem::file_size(file, size_ec));
+			if (size_ec) {
+				continue;
+			}
+			if (file_size <= split_size_) {
+				ranges.push_back({ file, 0, 0 });
+				items.push_back({ key, file_size });
+				continue;
+			}
+
+			const size_t pieces = (file_size + split_size_ - 1) / split_size_;
+			size_t begin = 0;
+			for (size_t i = 1; i <= pieces; ++i) {
+				size_t end = file_size;
+				if (i < pieces) {
+					end = FindBoundary(file, file_size / pieces * i, file_size, ec);
+					if (ec) {
+						return {};
+					}
+					if (end <= begin || end >= file_size) {
+						continue;
+					}
+				}
+				ranges.push_back({ file, begin, end });
+				items.push_back({ key + L"#" + std::to_wstring(begin), end - begin });
+				begin = end;
+			}
+		}
+
+		std::vector<size_t> owners = Balance(items, count_);
+		for (size_t i = 0; i < ranges.size(); ++i) {
+			if (owners[i] == index_ - 1) {
+				selected.push_back(ranges[i]);
+			}
+		}
+		return selected;
+	}
+
+	std::vector<size_t> ShardPlan::Select(const std::vector<Item>& items) const {
+		std::vector<size_t> owners = Balance(items, count_);
+		std::vector<size_t> selected;
+		for (size_t i = 0; i < items.size(); ++i) {
+			if (owners[i] == index_ - 1) {
+				selected.push_back(i);
+			}
+		}
+		return selected;
+	}
+
+	uint64_t ShardPlan::hash(const std::wstring& str) {
+		//FNV-1a: одинаковый результат во всех процессах и на всех платформах
+		uint64_t value = 14695981039346656037ULL;
+		for (wchar_t c : str) {
+			value ^= static_cast<uint32_t>(c);
+			value *= 1099511628211ULL;
+		}
+		return value;
+	}
+
+}
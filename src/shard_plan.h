@@ -0,0 +1,54 @@
+#pragma once
+
+#include <filesystem>
+#include <string>
+#include <vector>
+#include <system_error>
+
+namespace soldy {
+
+	//Детерминированное разделение дерева журналов между несколькими процессами (--shard=i/N).
+	//Каждый процесс сам строит один и тот же план по списку файлов и их размерам и берет свою часть,
+	//согласование между процессами не нужно.
+	class ShardPlan {
+	public:
+		//Часть файла [begin, end), end == 0 - весь файл
+		struct FileRange {
+			std::filesystem::path path;
+			size_t begin = 0;
+			size_t end = 0;
+		};
+		struct Item {
+			std::wstring key;
+			size_t size = 0;
+		};
+
+		//Границы частей файла выравниваются на 64 КБ (гранулярность проецирования в Windows), чтобы процессы
+		//не писали в одни и те же страницы: на NFS/SMB страница записывается целиком
+		static constexpr size_t RANGE_ALIGNMENT = 64 * 1024;
+		static constexpr size_t DEFAULT_SPLIT_SIZE = 1024ULL * 1024 * 1024;
+
+		//index от 1 до count
+		ShardPlan(size_t index, size_t count, size_t split_size = DEFAULT_SPLIT_SIZE);
+
+		//Разбор "i/N"
+		static bool Parse(const std::wstring& value, size_t& index, size_t& count);
+		//Номер шарда (от 0) для каждого элемента: по убыванию размера в наименее загруженный шард
+		static std::vector<size_t> Balance(const std::vector<Item>& items, size_t count);
+		//Граница части файла: первое смещение, кратное RANGE_ALIGNMENT, не меньше offset, не разрывающее пару CR LF
+		//(в любом виде, до или после преобразования). Возвращает file_size, если такой границы нет.
+		static size_t FindBoundary(const std::filesystem::path& file, size_t offset, size_t file_size, std::error_code& ec);
+
+		//Части файлов этого процесса. Файлы больше split_size делятся на части. Сжатые файлы не делятся
+		//и распределяются по хешу пути: их размер меняется при обработке другим процессом.
+		std::vector<FileRange> Assign(const std::vector<std::filesystem::path>& files, const std::filesystem::path& root, std::error_code& ec) const;
+		//Элементы этого процесса (например, часы в режиме merge)
+		std::vector<size_t> Select(const std::vector<Item>& items) const;
+	private:
+		size_t index_;
+		size_t count_;
+		size_t split_size_;
+		static uint64_t hash(const std::wstring& str);
+	};
+
+}
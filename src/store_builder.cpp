@@ -0,0 +1,186 @@
+#include "store_builder.h"
+
+#include <algorithm>
+#include "event_store.h"
+#include "event_reader.h"
+#include "log_event.h"
+
+namespace soldy {
+
+	namespace {
+		const char MAGIC[8] = { 'F', 'L', 'A', 'T', 'S', 'T', 'O', '1' };
+
+		void write_string(std::ofstream& stream, const std::string& value) {
+			const uint32_t size = static_cast<uint32_t>(value.size());
+			stream.write(reinterpret_cast<const char*>(&size), sizeof(size));
+			stream.write(value.data(), value.size());
+		}
+	}
+
+	uint32_t StoreBuilder::Dictionary::Id(std::string_view value) {
+		if (value.empty()) {
+			return 0;
+		}
+		auto [it, is_new] = ids.try_emplace(std::string(value), static_cast<uint32_t>(values.size()));
+		if (is_new) {
+			values.push_back(it->first);
+		}
+		return it->second;
+	}
+
+	StoreBuilder::StoreBuilder(const std::vector<std::string>& properties, SimdSupport::SimdLevel simd_level)
+		: simd_level_(simd_level) {
+		//Процесс нужен для отбора всегда, поэтому его столбец строится и без --columns
+		properties_.push_back("process");
+		for (const auto& property : properties) {
+			if (std::find(properties_.begin(), properties_.end(), property) == properties_.end()) {
+				properties_.push_back(property);
+			}
+		}
+		for (const auto& property : properties_) {
+			finders_.emplace_back("," + property + "=", simd_level);
+		}
+	}
+
+	bool StoreBuilder::Build(const std::filesystem::path& file, uint64_t hour_time, std::error_code& ec) {
+		const std::filesystem::path store = EventStore::StorePath(file);
+		std::filesystem::path temp = store;
+		temp += L".tmp";
+		std::filesystem::remove_all(temp, ec);
+		if (ec || !std::filesystem::create_directories(temp, ec)) {
+			ec = ec ? ec : std::make_error_code(std::errc::file_exists);
+			return false;
+		}
+		if (!build(file, temp, hour_time, ec)) {
+			std::error_code remove_ec;
+			std::filesystem::remove_all(temp, remove_ec);
+			return false;
+		}
+		std::filesystem::remove_all(store, ec);
+		if (!ec) {
+			std::filesystem::rename(temp, store, ec);
+		}
+		if (ec) {
+			std::error_code remove_ec;
+			std::filesystem::remove_all(temp, remove_ec);
+			return false;
+		}
+		return true;
+	}
+
+	bool StoreBuilder::build(const std::filesystem::path& file, const std::filesystem::path& dir, uint64_t hour_time, std::error_code& ec) {
+		source_size_ = 0;
+		events_ = 0;
+		store_size_ = 0;
+		EventReader reader(simd_level_);
+		if (!reader.Open(file, ec)) {
+			return false;
+		}
+		source_size_ = reader.FileSize();
+
+		std::vector<Column> columns(EventStore::PROPERTIES + properties_.size());
+		for (size_t i = 0; i < columns.size(); ++i) {
+			columns[i].stream.open(EventStore::ColumnPath(dir, i), std::ios::binary | std::ios::trunc);
+			if (!columns[i].stream) {
+				ec = std::make_error_code(std::errc::permission_denied);
+				return false;
+			}
+		}
+		Dictionary names;
+		std::vector<Dictionary> values(properties_.size());
+		while (reader.Next(ec)) {
+			const char* event = reader.Data();
+			const char* end = event + reader.Size();
+			std::string_view name;
+			uint64_t duration = 0;
+			if (LogEvent::ParseHeader(event, reader.Size(), name, duration) != LogEvent::Header::Parsed) {
+				name = std::string_view();
+				duration = 0;
+			}
+			bool is_ok = append(columns[EventStore::TIME], static_cast<uint32_t>(reader.Timestamp()), ec)
+				&& append(columns[EventStore::DURATION], duration, ec)
+				&& append(columns[EventStore::EVENT], names.Id(name), ec)
+				&& append(columns[EventStore::OFFSET], static_cast<uint64_t>(reader.Offset()), ec);
+			//Значение первого вхождения свойства
+			for (size_t i = 0; is_ok && i < properties_.size(); ++i) {
+				uint32_t id = 0;
+				if (const char* ch = finders_[i].Find(event, end)) {
+					const char* value = ch + finders_[i].Size();
+					id = values[i].Id(std::string_view(value, LogEvent::PropertyValueEnd(value, end) - value));
+				}
+				is_ok = append(columns[EventStore::PROPERTIES + i], id, ec);
+			}
+			if (!is_ok) {
+				return false;
+			}
+			++events_;
+		}
+		if (ec) {
+			return false;
+		}
+		for (auto& column : columns) {
+			if (!flush(column, ec)) {
+				return false;
+			}
+			column.stream.close();
+		}
+		if (!write_meta(dir, source_size_, events_, hour_time, properties_, names, values, ec)) {
+			return false;
+		}
+		for (const auto& entry : std::filesystem::directory_iterator(dir, ec)) {
+			store_size_ += entry.file_size(ec);
+		}
+		return !ec;
+	}
+
+	bool StoreBuilder::write_meta(const std::filesystem::path& dir, uint64_t source_size, uint64_t events, uint64_t hour_time,
+		const std::vector<std::string>& properties, const Dictionary& names, const std::vector<Dictionary>& values, std::error_code& ec) {
+		std::ofstream stream(dir / L"meta", std::ios::binary | std::ios::trunc);
+		if (!stream) {
+			ec = std::make_error_code(std::errc::permission_denied);
+			return false;
+		}
+		const uint32_t count = static_cast<uint32_t>(properties.size());
+		stream.write(MAGIC, sizeof(MAGIC));
+		stream.write(reinterpret_cast<const char*>(&source_size), sizeof(source_size));
+		stream.write(reinterpret_cast<const char*>(&events), sizeof(events));
+		stream.write(reinterpret_cast<const char*>(&hour_time), sizeof(hour_time));
+		stream.write(reinterpret_cast<const char*>(&count), sizeof(count));
+		for (const auto& property : properties) {
+			write_string(stream, property);
+		}
+		auto write_dictionary = [&stream](const Dictionary& dictionary) {
+			const uint32_t size = static_cast<uint32_t>(dictionary.values.size());
+			stream.write(reinterpret_cast<const char*>(&size), sizeof(size));
+			for (const auto& value : dictionary.values) {
+				write_string(stream, value);
+			}
+		};
+		write_dictionary(names);
+		for (const auto& dictionary : values) {
+			write_dictionary(dictionary);
+		}
+		if (!stream.flush()) {
+			ec = std::make_error_code(std::errc::io_error);
+			return false;
+		}
+		return true;
+	}
+
+	template<typename T>
+	bool StoreBuilder::append(Column& column, T value, std::error_code& ec) {
+		column.buffer.append(reinterpret_cast<const char*>(&value), sizeof(value));
+		return column.buffer.size() < FLUSH_SIZE || flush(column, ec);
+	}
+
+	bool StoreBuilder::flush(Column& column, std::error_code& ec) {
+		column.stream.write(column.buffer.data(), column.buffer.size());
+		column.buffer.clear();
+		if (!column.stream) {
+			ec = std::make_error_code(std::errc::io_error);
+			return false;
+		}
+		return true;
+	}
+
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+#include <fstream>
+#include <system_error>
+#include "simd_support.h"
+#include "substring_finder.h"
+
+namespace soldy {
+
+	//Построение столбцового хранилища событий flat-журнала (<файл>.store, см. EventStore) за один проход чтения.
+	//Строки (имена событий, значения свойств) кодируются номерами в словаре, каждый столбец пишется в свой файл.
+	//Хранилище собирается в <файл>.store.tmp и переименовывается: читатель не увидит неполное хранилище.
+	class StoreBuilder {
+	public:
+		StoreBuilder(const std::vector<std::string>& properties, SimdSupport::SimdLevel simd_level);
+		StoreBuilder(const StoreBuilder&) = delete;
+		StoreBuilder& operator=(const StoreBuilder&) = delete;
+
+		//hour_time - начало часа файла в микросекундах (час из имени файла)
+		bool Build(const std::filesystem::path& file, uint64_t hour_time, std::error_code& ec);
+		//Свойства столбцов хранилища: process и заданные
+		const std::vector<std::string>& Properties() const noexcept { return properties_; }
+		uint64_t SourceSize() const noexcept { return source_size_; }
+		uint64_t Events() const noexcept { return events_; }
+		//Общий размер файлов хранилища
+		uint64_t StoreSize() const noexcept { return store_size_; }
+	private:
+		//Номер 0 - пустое или отсутствующее значение
+		struct Dictionary {
+			std::unordered_map<std::string, uint32_t> ids;
+			std::vector<std::string> values{ "" };
+
+			uint32_t Id(std::string_view value);
+		};
+		//Столбец копится в буфере и сбрасывается в файл порциями
+		struct Column {
+			std::ofstream stream;
+			std::string buffer;
+		};
+		static constexpr size_t FLUSH_SIZE = 1024 * 1024;
+
+		SimdSupport::SimdLevel simd_level_;
+		std::vector<std::string> properties_;
+		std::vector<SubstringFinder> finders_;
+		uint64_t source_size_ = 0;
+		uint64_t events_ = 0;
+		uint64_t store_size_ = 0;
+		bool build(const std::filesystem::path& file, const std::filesystem::path& dir, uint64_t hour_time, std::error_code& ec);
+		static bool write_meta(const std::filesystem::path& dir, uint64_t source_size, uint64_t events, uint64_t hour_time,
+			const std::vector<std::string>& properties, const Dictionary& names, const std::vector<Dictionary>& values, std::error_code& ec);
+		template<typename T>
+		static bool append(Column& column, T value, std::error_code& ec);
+		static bool flush(Column& column, std::error_code& ec);
+	};
+
+}
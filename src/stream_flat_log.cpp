@@ -0,0 +1,171 @@
+#include "stream_flat_log.h"
+
+#include <thread>
+#include <cstring>
+#include "blocking_queue.h"
+
+namespace soldy {
+
+	StreamFlatLog::StreamFlatLog(const std::filesystem::path& file_path) : file_path_(file_path) {
+		SimdSupport simd_support;
+		simd_level_ = simd_support.BestLevel();
+	}
+
+	bool StreamFlatLog::Process(FlatLog::Mode mode, Codec out_codec, std::error_code& ec) {
+		size_ = 0;
+		const Codec in_codec = CodecFromPath(file_path_);
+		std::wstring name = file_path_.filename().wstring();
+		name.resize(name.size() - CodecExtension(in_codec).size());
+		output_path_ = file_path_.parent_path() / (name + CodecExtension(out_codec));
+		std::filesystem::path temp_path = output_path_;
+		temp_path += L".tmp";
+
+		CompressedReader reader;
+		if (!reader.Open(file_path_, in_codec, ec)) {
+			return false;
+		}
+		//Рядом может лежать другой файл с именем результата (24010110.log и 24010110.log.gz): его не затираем
+		if (!is_dry_run_ && output_path_ != file_path_ && std::filesystem::exists(output_path_, ec)) {
+			ec = std::make_error_code(std::errc::file_exists);
+			return false;
+		}
+		if (ec) {
+			return false;
+		}
+		CompressedWriter writer;
+		if (!is_dry_run_ && !writer.Open(temp_path, out_codec, ec)) {
+			return false;
+		}
+
+		BlockingQueue<Chunk> decoded(QUEUE_CAPACITY);
+		BlockingQueue<Chunk> processed(QUEUE_CAPACITY);
+		std::error_code read_ec;
+		std::error_code write_ec;
+
+		Throttle* throttle = throttle_;
+		LogHash* hash = hash_;
+		std::thread read_thread([&reader, &decoded, &read_ec, throttle, hash]() {
+			ThreadCpuMeter cpu(throttle);
+			while (true) {
+				Chunk chunk;
+				chunk.buffer.resize(CHUNK_HEADROOM + CHUNK_SIZE);
+				chunk.begin = chunk.end = CHUNK_HEADROOM;
+				size_t size = reader.Read(chunk.buffer.data() + chunk.begin, CHUNK_SIZE, read_ec);
+				if (!size) {
+					break;
+				}
+				chunk.end += size;
+				if (hash) {
+					hash->Update(chunk.buffer.data() + chunk.begin, size);
+				}
+				if (throttle) {
+					throttle->Io(size);
+				}
+				cpu.Charge();
+				if (!decoded.Push(std::move(chunk))) {
+					break;
+				}
+			}
+			decoded.Close();
+		});
+
+		const bool is_dry_run = is_dry_run_;
+		std::thread write_thread([&writer, &processed, &write_ec, throttle, is_dry_run]() {
+			ThreadCpuMeter cpu(throttle);
+			Chunk chunk;
+			//При ошибке записи очередь все равно вычитываем, чтобы не остановить обработку
+			while (processed.Pop(chunk)) {
+				if (!write_ec && !is_dry_run) {
+					writer.Write(chunk.buffer.data() + chunk.begin, chunk.end - chunk.begin, write_ec);
+				}
+				cpu.Charge();
+			}
+		});
+
+		//Необработанный хвост предыдущего фрагмента. Если has_prev, carry[0] - уже обработанный символ,
+		//который еще может измениться (CR перед '\n' в начале следующего фрагмента)
+		FlatLog flat_log(file_path_.string());
+		flat_log.SetSimdLevel(simd_level_);
+		std::vector<char> carry;
+		bool has_prev = false;
+
+		ThreadCpuMeter cpu(throttle);
+		Chunk chunk;
+		bool has_chunk = decoded.Pop(chunk);
+		while (has_chunk) {
+			Chunk next;
+			bool has_next = decoded.Pop(next);
+
+			attach_carry(chunk, carry);
+			char* region = chunk.buffer.data() + chunk.begin;
+			const size_t region_size = chunk.end - chunk.begin;
+			const size_t skip = has_prev ? 1 : 0;
+			if (!has_prev) {
+				*(region - 1) = 0;
+			}
+
+			size_t done = flat_log.ProcessBuffer(mode, region + skip, region_size - skip, !has_next);
+			size_t final_size = region_size;
+			if (has_next) {
+				final_size = done ? skip + done - 1 : 0;
+				has_prev = has_prev || done;
+			}
+			carry.assign(region + final_size, region + region_size);
+
+			cpu.Charge();
+
+			size_ += final_size;
+			chunk.end = chunk.begin + final_size;
+			if (final_size) {
+				processed.Push(std::move(chunk));
+			}
+
+			chunk = std::move(next);
+			has_chunk = has_next;
+		}
+
+		processed.Close();
+		read_thread.join();
+		write_thread.join();
+		changes_ = flat_log.GetChanges();
+		if (is_dry_run_) {
+			ec = read_ec;
+			return !ec;
+		}
+
+		std::error_code close_ec;
+		bool is_closed = writer.Close(close_ec);
+		ec = read_ec ? read_ec : write_ec ? write_ec : close_ec;
+		if (ec || !is_closed) {
+			std::error_code remove_ec;
+			std::filesystem::remove(temp_path, remove_ec);
+			return false;
+		}
+
+		std::filesystem::rename(temp_path, output_path_, ec);
+		if (ec) {
+			return false;
+		}
+		if (output_path_ != file_path_) {
+			std::filesystem::remove(file_path_, ec);
+		}
+		return !ec;
+	}
+
+	void StreamFlatLog::attach_carry(Chunk& chunk, const std::vector<char>& carry) {
+		//Перед данными нужен еще один символ: предыдущий для первого '\n' фрагмента
+		if (chunk.begin < carry.size() + 1) {
+			Chunk bigger;
+			bigger.buffer.resize(CHUNK_HEADROOM + carry.size() + (chunk.end - chunk.begin));
+			bigger.begin = CHUNK_HEADROOM + carry.size();
+			bigger.end = bigger.buffer.size();
+			std::memcpy(bigger.buffer.data() + bigger.begin, chunk.buffer.data() + chunk.begin, chunk.end - chunk.begin);
+			chunk = std::move(bigger);
+		}
+		chunk.begin -= carry.size();
+		if (!carry.empty()) {
+			std::memcpy(chunk.buffer.data() + chunk.begin, carry.data(), carry.size());
+		}
+	}
+
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <filesystem>
+#include <vector>
+#include "flat_log.h"
+#include "compressed_file.h"
+#include "simd_support.h"
+#include "throttle.h"
+#include "log_hash.h"
+
+namespace soldy {
+
+	//Обработка сжатых журналов за один проход без промежуточных файлов:
+	//поток распаковки -> обработка SIMD-ядрами FlatLog в вызывающем потоке -> поток сжатия и записи.
+	//Потоки обмениваются фрагментами через ограниченные очереди, объем памяти не зависит от размера файла.
+	class StreamFlatLog {
+	private:
+		struct Chunk {
+			std::vector<char> buffer;
+			size_t begin = 0;
+			size_t end = 0;
+		};
+		std::filesystem::path file_path_;
+		std::filesystem::path output_path_;
+		SimdSupport::SimdLevel simd_level_;
+		Throttle* throttle_ = nullptr;
+		LogHash* hash_ = nullptr;
+		bool is_dry_run_ = false;
+		FlatLog::Changes changes_;
+		size_t size_ = 0;
+		static void attach_carry(Chunk& chunk, const std::vector<char>& carry);
+	public:
+		static constexpr size_t CHUNK_SIZE = 8 * 1024 * 1024;
+		//Место перед данными фрагмента под необработанный хвост предыдущего
+		static constexpr size_t CHUNK_HEADROOM = 4096;
+		static constexpr size_t QUEUE_CAPACITY = 4;
+
+		//Наибольший объем памяти под фрагменты: обе очереди и по фрагменту в каждом потоке
+		static constexpr size_t MemoryFootprint() { return (2 * QUEUE_CAPACITY + 3) * (CHUNK_HEADROOM + CHUNK_SIZE); }
+
+		explicit StreamFlatLog(const std::filesystem::path& file_path);
+		void SetSimdLevel(SimdSupport::SimdLevel simd_level) { simd_level_ = simd_level; }
+		//Скорость считается по распакованным данным, процессорное время - по всем трем потокам
+		void SetThrottle(Throttle* throttle) { throttle_ = throttle; }
+		//Хеш распакованных исходных данных, считается в потоке распаковки
+		void SetHash(LogHash* hash) { hash_ = hash; }
+		//Только распаковка и подсчет изменений, результат не записывается
+		void SetDryRun(bool is_dry_run) { is_dry_run_ = is_dry_run; }
+		const FlatLog::Changes& GetChanges() const noexcept { return changes_; }
+		//Результат заменяет исходный файл, расширение определяется out_codec (*.log, *.log.gz, *.log.zst)
+		bool Process(FlatLog::Mode mode, Codec out_codec, std::error_code& ec);
+		//Размер распакованных данных
+		size_t Size() const noexcept { return size_; }
+		const std::filesystem::path& OutputPath() const noexcept { return output_path_; }
+	};
+
+}
@@ -0,0 +1,89 @@
+#include "substring_finder.h"
+
+#include <cstring>
+#include <immintrin.h>
+#include "log_event.h"
+
+namespace soldy {
+
+	SubstringFinder::SubstringFinder(const std::string& needle, SimdSupport::SimdLevel simd_level)
+		: needle_(needle), simd_level_(simd_level) {
+	}
+
+	const char* SubstringFinder::Find(const char* begin, const char* end) const {
+		if (needle_.empty() || static_cast<size_t>(end - begin) < needle_.size()) {
+			return needle_.empty() ? begin : nullptr;
+		}
+		if (simd_level_ == SimdSupport::SimdLevel::AVX512) {
+			return find_512(begin, end);
+		}
+		if (simd_level_ == SimdSupport::SimdLevel::AVX2) {
+			return find_256(begin, end);
+		}
+		return find_none(begin, end);
+	}
+
+#ifdef __linux__
+	__attribute__((target("avx512f,avx512bw")))
+#endif
+	const char* SubstringFinder::find_512(const char* begin, const char* end) const {
+		const size_t last = needle_.size() - 1;
+		const __m512i first_ch = _mm512_set1_epi8(needle_.front());
+		const __m512i last_ch = _mm512_set1_epi8(needle_.back());
+		const char* ch = begin;
+		//Блок последних символов читается со сдвигом на длину образца
+		for (; ch + last + 64 <= end; ch += 64) {
+			__m512i block_first = _mm512_loadu_si512(reinterpret_cast<const __m512i*>(ch));
+			__m512i block_last = _mm512_loadu_si512(reinterpret_cast<const __m512i*>(ch + last));
+			uint64_t mask = _mm512_cmpeq_epi8_mask(block_first, first_ch) & _mm512_cmpeq_epi8_mask(block_last, last_ch);
+			for (; mask != 0; mask &= mask - 1) {
+				const char* candidate = ch + CTZ64(mask);
+				if (is_match(candidate)) {
+					return candidate;
+				}
+			}
+		}
+		return find_none(ch, end);
+	}
+
+#ifdef __linux__
+	__attribute__((target("avx2")))
+#endif
+	const char* SubstringFinder::find_256(const char* begin, const char* end) const {
+		const size_t last = needle_.size() - 1;
+		const __m256i first_ch = _mm256_set1_epi8(needle_.front());
+		const __m256i last_ch = _mm256_set1_epi8(needle_.back());
+		const char* ch = begin;
+		for (; ch + last + 32 <= end; ch += 32) {
+			__m256i block_first = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(ch));
+			__m256i block_last = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(ch + last));
+			uint32_t mask = _mm256_movemask_epi8(_mm256_and_si256(_mm256_cmpeq_epi8(block_first, first_ch), _mm256_cmpeq_epi8(block_last, last_ch)));
+			for (; mask != 0; mask &= mask - 1) {
+				const char* candidate = ch + CTZ32(mask);
+				if (is_match(candidate)) {
+					return candidate;
+				}
+			}
+		}
+		return find_none(ch, end);
+	}
+
+	const char* SubstringFinder::find_none(const char* begin, const char* end) const {
+		const char* last = end - needle_.size();
+		for (const char* ch = begin; ch <= last; ++ch) {
+			ch = static_cast<const char*>(std::memchr(ch, needle_.front(), last - ch + 1));
+			if (!ch) {
+				return nullptr;
+			}
+			if (is_match(ch)) {
+				return ch;
+			}
+		}
+		return nullptr;
+	}
+
+	bool SubstringFinder::is_match(const char* ch) const {
+		return std::memcmp(ch + 1, needle_.data() + 1, needle_.size() - 1) == 0;
+	}
+
+}
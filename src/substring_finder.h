@@ -0,0 +1,26 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include "simd_support.h"
+
+namespace soldy {
+
+	//Поиск подстроки с SIMD-префильтром: блок сравнивается с первым и последним символом образца,
+	//и только совпавшие позиции проверяются целиком. Для образцов вида ",SessionID=" кандидатов почти нет.
+	class SubstringFinder {
+	public:
+		SubstringFinder(const std::string& needle, SimdSupport::SimdLevel simd_level);
+		//Первое вхождение в [begin, end) или nullptr
+		const char* Find(const char* begin, const char* end) const;
+		size_t Size() const noexcept { return needle_.size(); }
+	private:
+		std::string needle_;
+		SimdSupport::SimdLevel simd_level_;
+		const char* find_512(const char* begin, const char* end) const;
+		const char* find_256(const char* begin, const char* end) const;
+		const char* find_none(const char* begin, const char* end) const;
+		bool is_match(const char* ch) const;
+	};
+
+}
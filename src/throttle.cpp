@@ -0,0 +1,119 @@
+#include "throttle.h"
+
+#include <algorithm>
+#include <thread>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <ctime>
+#include <cerrno>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#endif
+
+namespace soldy {
+
+	TokenBucket::TokenBucket(double rate, double capacity)
+		: rate_(rate), capacity_(capacity), tokens_(capacity), last_(std::chrono::steady_clock::now()) {
+	}
+
+	std::chrono::microseconds TokenBucket::Take(double amount) {
+		if (rate_ <= 0) {
+			return std::chrono::microseconds(0);
+		}
+		std::lock_guard<std::mutex> lock(mutex_);
+		auto now = std::chrono::steady_clock::now();
+		double elapsed = std::chrono::duration<double>(now - last_).count();
+		last_ = now;
+		tokens_ = (std::min)(capacity_, tokens_ + elapsed * rate_);
+		tokens_ -= amount;
+		if (tokens_ >= 0) {
+			return std::chrono::microseconds(0);
+		}
+		return std::chrono::microseconds(static_cast<int64_t>(-tokens_ / rate_ * 1e6));
+	}
+
+	Throttle::Throttle(size_t max_io, size_t max_cpu)
+		//Запас корзины ввода-вывода - одна секунда, процессора - 100 мс
+		: io_(static_cast<double>(max_io) * 1024 * 1024, static_cast<double>(max_io) * 1024 * 1024),
+		cpu_(static_cast<double>(max_cpu) / 100 * 1e6, static_cast<double>(max_cpu) / 100 * 1e5),
+		io_limited_(max_io != 0), cpu_limited_(max_cpu != 0) {
+	}
+
+	void Throttle::Io(size_t bytes) {
+		if (io_limited_) {
+			wait(io_.Take(static_cast<double>(bytes)));
+		}
+	}
+
+	void Throttle::Cpu(std::chrono::microseconds used) {
+		if (cpu_limited_) {
+			wait(cpu_.Take(static_cast<double>(used.count())));
+		}
+	}
+
+	void Throttle::wait(std::chrono::microseconds duration) {
+		if (duration.count() > 0) {
+			throttled_us_ += duration.count();
+			std::this_thread::sleep_for(duration);
+		}
+	}
+
+	std::chrono::microseconds Throttle::ThreadCpuTime() {
+#ifdef _WIN32
+		FILETIME creation, exit, kernel, user;
+		if (!GetThreadTimes(GetCurrentThread(), &creation, &exit, &kernel, &user)) {
+			return std::chrono::microseconds(0);
+		}
+		auto to_100ns = [](const FILETIME& ft) { return (static_cast<uint64_t>(ft.dwHighDateTime) << 32) | ft.dwLowDateTime; };
+		return std::chrono::microseconds((to_100ns(kernel) + to_100ns(user)) / 10);
+#else
+		timespec ts{};
+		clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+		return std::chrono::microseconds(static_cast<int64_t>(ts.tv_sec) * 1000000 + ts.tv_nsec / 1000);
+#endif
+	}
+
+	bool Throttle::LowerPriority(int nice, const std::wstring& ioprio, std::error_code& ec) {
+#ifdef _WIN32
+		//В Windows приоритет ввода-вывода понижается фоновым режимом процесса
+		if (ioprio == L"idle" || ioprio == L"low") {
+			if (!SetPriorityClass(GetCurrentProcess(), PROCESS_MODE_BACKGROUND_BEGIN)) {
+				ec = std::error_code(GetLastError(), std::system_category());
+				return false;
+			}
+		}
+		if (nice > 0) {
+			if (!SetPriorityClass(GetCurrentProcess(), nice >= 10 ? IDLE_PRIORITY_CLASS : BELOW_NORMAL_PRIORITY_CLASS)) {
+				ec = std::error_code(GetLastError(), std::system_category());
+				return false;
+			}
+		}
+#else
+		if (nice > 0 && setpriority(PRIO_PROCESS, 0, nice) == -1) {
+			ec = std::error_code(errno, std::system_category());
+			return false;
+		}
+#ifdef SYS_ioprio_set
+		static const int IOPRIO_WHO_PROCESS = 1;
+		static const int IOPRIO_CLASS_SHIFT = 13;
+		static const int IOPRIO_CLASS_BE = 2;
+		static const int IOPRIO_CLASS_IDLE = 3;
+		int value = -1;
+		if (ioprio == L"idle") {
+			value = IOPRIO_CLASS_IDLE << IOPRIO_CLASS_SHIFT;
+		}
+		else if (ioprio == L"low") {
+			value = (IOPRIO_CLASS_BE << IOPRIO_CLASS_SHIFT) | 7;
+		}
+		if (value != -1 && syscall(SYS_ioprio_set, IOPRIO_WHO_PROCESS, 0, value) == -1) {
+			ec = std::error_code(errno, std::system_category());
+			return false;
+		}
+#endif
+#endif
+		return true;
+	}
+
+}
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <chrono>
+#include <mutex>
+#include <atomic>
+#include <string>
+#include <system_error>
+
+namespace soldy {
+
+	//Корзина маркеров: пополняется со скоростью rate единиц в секунду, не больше capacity.
+	//Списание может уйти в долг, долг оплачивается ожиданием - так несколько потоков делят одну скорость.
+	class TokenBucket {
+	private:
+		double rate_;
+		double capacity_;
+		double tokens_;
+		std::chrono::steady_clock::time_point last_;
+		std::mutex mutex_;
+	public:
+		TokenBucket(double rate, double capacity);
+		//Списывает amount и возвращает время, которое нужно подождать
+		std::chrono::microseconds Take(double amount);
+	};
+
+	//Ограничение скорости ввода-вывода и загрузки процессора, общее для всех потоков обработки.
+	//Нужно для запуска на рабочем сервере 1С, чтобы не увеличивать очередь диска и задержки пользователей.
+	class Throttle {
+	private:
+		TokenBucket io_;
+		TokenBucket cpu_;
+		bool io_limited_;
+		bool cpu_limited_;
+		std::atomic<uint64_t> throttled_us_{ 0 };
+		void wait(std::chrono::microseconds duration);
+	public:
+		//max_io - МБ/с, max_cpu - проценты одного ядра (200 - два ядра), 0 - без ограничения
+		Throttle(size_t max_io, size_t max_cpu);
+		Throttle(const Throttle&) = delete;
+		Throttle& operator=(const Throttle&) = delete;
+
+		bool IsIoLimited() const noexcept { return io_limited_; }
+		bool IsLimited() const noexcept { return io_limited_ || cpu_limited_; }
+		//Перед чтением/записью bytes байт: ждет, если превышена скорость
+		void Io(size_t bytes);
+		//После обработки: списывает затраченное потоком процессорное время
+		void Cpu(std::chrono::microseconds used);
+		//Суммарное время ожидания всех потоков
+		std::chrono::microseconds Throttled() const noexcept { return std::chrono::microseconds(throttled_us_.load()); }
+
+		//Процессорное время текущего потока
+		static std::chrono::microseconds ThreadCpuTime();
+		//Понижает приоритет процесса: nice (0 - не менять) и приоритет ввода-вывода (idle, low, пусто - не менять).
+		//Вызывается до запуска потоков, они наследуют приоритет.
+		static bool LowerPriority(int nice, const std::wstring& ioprio, std::error_code& ec);
+	};
+
+	//Учет процессорного времени потока между вызовами Charge
+	class ThreadCpuMeter {
+	private:
+		Throttle* throttle_;
+		std::chrono::microseconds start_;
+	public:
+		explicit ThreadCpuMeter(Throttle* throttle)
+			: throttle_(throttle), start_(throttle ? Throttle::ThreadCpuTime() : std::chrono::microseconds(0)) {}
+		void Charge() {
+			if (throttle_) {
+				auto now = Throttle::ThreadCpuTime();
+				throttle_->Cpu(now - start_);
+				start_ = Throttle::ThreadCpuTime();
+			}
+		}
+	};
+
+}
@@ -0,0 +1,242 @@
+#include "trace_collector.h"
+
+#include <algorithm>
+#include <atomic>
+#include <fstream>
+#include <functional>
+#include <memory>
+#include <queue>
+#include "event_writer.h"
+
+namespace soldy {
+
+	namespace {
+		const size_t RUN_BUFFER_SIZE = 256 * 1024;
+
+		//Запись серии: ключ (3 x uint64), размер метки и события (2 x uint32), метка, событие
+		struct RunRecord {
+			TraceCollector::Key key;
+			std::string label;
+			std::string event;
+		};
+
+		class RunWriter {
+		private:
+			std::vector<char> buffer_;
+			std::ofstream out_;
+		public:
+			RunWriter() : buffer_(RUN_BUFFER_SIZE) {}
+			bool Open(const std::filesystem::path& path, std::error_code& ec) {
+				out_.rdbuf()->pubsetbuf(buffer_.data(), buffer_.size());
+				out_.open(path, std::ios::binary | std::ios::trunc);
+				if (!out_) {
+					ec = std::make_error_code(std::errc::io_error);
+					return false;
+				}
+				return true;
+			}
+			void Write(const TraceCollector::Key& key, const char* label, uint32_t label_size, const char* event, uint32_t event_size) {
+				out_.write(reinterpret_cast<const char*>(&key.time), sizeof(key.time));
+				out_.write(reinterpret_cast<const char*>(&key.file), sizeof(key.file));
+				out_.write(reinterpret_cast<const char*>(&key.offset), sizeof(key.offset));
+				out_.write(reinterpret_cast<const char*>(&label_size), sizeof(label_size));
+				out_.write(reinterpret_cast<const char*>(&event_size), sizeof(event_size));
+				out_.write(label, label_size);
+				out_.write(event, event_size);
+			}
+			bool Close(std::error_code& ec) {
+				out_.close();
+				if (out_.fail()) {
+					ec = std::make_error_code(std::errc::io_error);
+					return false;
+				}
+				return true;
+			}
+		};
+
+		class RunReader {
+		private:
+			std::vector<char> buffer_;
+			std::ifstream in_;
+		public:
+			RunRecord record;
+			RunReader() : buffer_(RUN_BUFFER_SIZE) {}
+			bool Open(const std::filesystem::path& path, std::error_code& ec) {
+				in_.rdbuf()->pubsetbuf(buffer_.data(), buffer_.size());
+				in_.open(path, std::ios::binary);
+				if (!in_) {
+					ec = std::make_error_code(std::errc::no_such_file_or_directory);
+					return false;
+				}
+				return true;
+			}
+			//false - серия закончилась или ошибка (ec)
+			bool Next(std::error_code& ec) {
+				uint32_t label_size = 0;
+				uint32_t event_size = 0;
+				if (!in_.read(reinterpret_cast<char*>(&record.key.time), sizeof(record.key.time))) {
+					if (!in_.eof() || in_.gcount()) {
+						ec = std::make_error_code(std::errc::io_error);
+					}
+					return false;
+				}
+				in_.read(reinterpret_cast<char*>(&record.key.file), sizeof(record.key.file));
+				in_.read(reinterpret_cast<char*>(&record.key.offset), sizeof(record.key.offset));
+				in_.read(reinterpret_cast<char*>(&label_size), sizeof(label_size));
+				in_.read(reinterpret_cast<char*>(&event_size), sizeof(event_size));
+				record.label.resize(label_size);
+				record.event.resize(event_size);
+				in_.read(record.label.data(), label_size);
+				in_.read(record.event.data(), event_size);
+				if (!in_) {
+					ec = std::make_error_code(std::errc::io_error);
+					return false;
+				}
+				return true;
+			}
+		};
+
+		//k-путевое слияние: текущие записи всех серий в куче
+		bool merge_runs(const std::vector<std::filesystem::path>& runs, const std::function<bool(const RunRecord&)>& sink, std::error_code& ec) {
+			std::vector<std::unique_ptr<RunReader>> readers;
+			using HeapItem = std::pair<TraceCollector::Key, size_t>;
+			auto greater = [](const HeapItem& a, const HeapItem& b) { return b.first < a.first; };
+			std::priority_queue<HeapItem, std::vector<HeapItem>, decltype(greater)> heap(greater);
+			for (const auto& run : runs) {
+				auto reader = std::make_unique<RunReader>();
+				if (!reader->Open(run, ec)) {
+					return false;
+				}
+				if (reader->Next(ec)) {
+					heap.emplace(reader->record.key, readers.size());
+				}
+				else if (ec) {
+					return false;
+				}
+				readers.push_back(std::move(reader));
+			}
+			while (!heap.empty()) {
+				size_t i = heap.top().second;
+				heap.pop();
+				RunReader& reader = *readers[i];
+				if (!sink(reader.record)) {
+					return false;
+				}
+				if (reader.Next(ec)) {
+					heap.emplace(reader.record.key, i);
+				}
+				else if (ec) {
+					return false;
+				}
+			}
+			return true;
+		}
+
+		void remove_runs(const std::vector<std::filesystem::path>& runs) {
+			std::error_code ec;
+			for (const auto& run : runs) {
+				std::filesystem::remove(run, ec);
+			}
+		}
+	}
+
+	TraceCollector::TraceCollector(const std::filesystem::path& run_dir, size_t buffer_limit)
+		: run_dir_(run_dir), buffer_limit_(buffer_limit) {
+	}
+
+	bool TraceCollector::Add(const Key& key, const std::string& label, const char* event, size_t size, std::error_code& ec) {
+		const size_t record_size = label.size() + size + sizeof(Entry);
+		if (!entries_.empty() && data_.size() + (entries_.size() + 1) * sizeof(Entry) + label.size() + size > buffer_limit_) {
+			if (!spill(ec)) {
+				return false;
+			}
+		}
+		if (data_.capacity() < buffer_limit_) {
+			//Буфер выделяется один раз при первом отобранном событии
+			data_.reserve(buffer_limit_);
+		}
+		entries_.push_back({ key, data_.size(), static_cast<uint32_t>(label.size()), static_cast<uint32_t>(size) });
+		data_.insert(data_.end(), label.begin(), label.end());
+		data_.insert(data_.end(), event, event + size);
+		++events_;
+		//Событие больше буфера сразу уходит в отдельную серию
+		return record_size <= buffer_limit_ || spill(ec);
+	}
+
+	bool TraceCollector::Finish(std::error_code& ec) {
+		bool result = entries_.empty() || spill(ec);
+		data_ = std::vector<char>();
+		entries_ = std::vector<Entry>();
+		return result;
+	}
+
+	bool TraceCollector::spill(std::error_code& ec) {
+		std::sort(entries_.begin(), entries_.end(), [](const Entry& a, const Entry& b) { return a.key < b.key; });
+		const std::filesystem::path path = run_path(run_dir_);
+		RunWriter writer;
+		if (!writer.Open(path, ec)) {
+			return false;
+		}
+		for (const auto& entry : entries_) {
+			const char* label = data_.data() + entry.offset;
+			writer.Write(entry.key, label, entry.label_size, label + entry.label_size, entry.event_size);
+		}
+		runs_.push_back(path);
+		entries_.clear();
+		data_.clear();
+		return writer.Close(ec);
+	}
+
+	std::filesystem::path TraceCollector::run_path(const std::filesystem::path& run_dir) {
+		static std::atomic<size_t> run_number{ 0 };
+		return run_dir / (L"trace_" + std::to_wstring(run_number++) + L".run");
+	}
+
+	bool TraceCollector::Merge(std::vector<std::filesystem::path> runs, const std::filesystem::path& run_dir,
+		const std::filesystem::path& output, size_t& events, std::error_code& ec) {
+		events = 0;
+		//Промежуточные проходы, пока серий больше, чем можно открыть одновременно
+		while (runs.size() > MAX_FAN_IN) {
+			std::vector<std::filesystem::path> merged;
+			for (size_t i = 0; i < runs.size(); i += MAX_FAN_IN) {
+				std::vector<std::filesystem::path> group(runs.begin() + i, runs.begin() + (std::min)(i + MAX_FAN_IN, runs.size()));
+				if (group.size() == 1) {
+					merged.push_back(group.front());
+					continue;
+				}
+				const std::filesystem::path path = run_path(run_dir);
+				RunWriter writer;
+				if (!writer.Open(path, ec)) {
+					return false;
+				}
+				auto sink = [&writer](const RunRecord& record) {
+					writer.Write(record.key, record.label.data(), static_cast<uint32_t>(record.label.size()),
+						record.event.data(), static_cast<uint32_t>(record.event.size()));
+					return true;
+				};
+				if (!merge_runs(group, sink, ec) || !writer.Close(ec)) {
+					return false;
+				}
+				remove_runs(group);
+				merged.push_back(path);
+			}
+			runs = std::move(merged);
+		}
+
+		EventWriter writer;
+		if (!writer.Open(output, ec)) {
+			return false;
+		}
+		auto sink = [&writer, &events, &ec](const RunRecord& record) {
+			++events;
+			return writer.Write(record.label.data(), record.label.size(), ec)
+				&& writer.WriteFlat(record.event.data(), record.event.size(), ec);
+		};
+		if (!merge_runs(runs, sink, ec) || !writer.Close(ec)) {
+			return false;
+		}
+		remove_runs(runs);
+		return true;
+	}
+
+}
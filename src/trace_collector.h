@@ -0,0 +1,61 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <filesystem>
+#include <string>
+#include <vector>
+#include <tuple>
+#include <system_error>
+
+namespace soldy {
+
+	//События трассировки, отобранные одним потоком. Буфер ограничен: при переполнении он сортируется по времени
+	//и сбрасывается во временный файл (серию) в run_dir. Итоговый файл собирается слиянием всех серий (Merge),
+	//поэтому объем архива влияет только на место на диске, но не на память.
+	class TraceCollector {
+	public:
+		//Порядок событий: время от начала часа файла, затем номер файла и смещение в нем
+		struct Key {
+			uint64_t time = 0;
+			uint64_t file = 0;
+			uint64_t offset = 0;
+			bool operator<(const Key& other) const noexcept {
+				return std::tie(time, file, offset) < std::tie(other.time, other.file, other.offset);
+			}
+		};
+		//Больше серий за один проход слияния не открывается
+		static constexpr size_t MAX_FAN_IN = 128;
+
+		TraceCollector(const std::filesystem::path& run_dir, size_t buffer_limit);
+		TraceCollector(const TraceCollector&) = delete;
+		TraceCollector& operator=(const TraceCollector&) = delete;
+
+		//label записывается перед событием (источник события)
+		bool Add(const Key& key, const std::string& label, const char* event, size_t size, std::error_code& ec);
+		//Сбрасывает остаток буфера в серию
+		bool Finish(std::error_code& ec);
+		const std::vector<std::filesystem::path>& Runs() const noexcept { return runs_; }
+		size_t Events() const noexcept { return events_; }
+
+		//Слияние серий в файл трассировки (события в плоском виде). Серии удаляются.
+		static bool Merge(std::vector<std::filesystem::path> runs, const std::filesystem::path& run_dir,
+			const std::filesystem::path& output, size_t& events, std::error_code& ec);
+	private:
+		struct Entry {
+			Key key;
+			size_t offset;
+			uint32_t label_size;
+			uint32_t event_size;
+		};
+		std::filesystem::path run_dir_;
+		size_t buffer_limit_;
+		std::vector<char> data_;
+		std::vector<Entry> entries_;
+		std::vector<std::filesystem::path> runs_;
+		size_t events_ = 0;
+		bool spill(std::error_code& ec);
+		static std::filesystem::path run_path(const std::filesystem::path& run_dir);
+	};
+
+}
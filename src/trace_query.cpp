@@ -0,0 +1,66 @@
+#include "trace_query.h"
+
+#include <algorithm>
+#include "log_event.h"
+
+namespace soldy {
+
+	TraceQuery::TraceQuery(SimdSupport::SimdLevel simd_level) : simd_level_(simd_level) {
+	}
+
+	void TraceQuery::Add(const std::string& property, const std::string& value) {
+		for (auto& item : properties_) {
+			if (item.name == property) {
+				item.values.insert(value);
+				return;
+			}
+		}
+		//Свойство события начинается после запятой: ",SessionID="
+		properties_.push_back({ property, SubstringFinder("," + property + "=", simd_level_), { value } });
+	}
+
+	bool TraceQuery::Match(const char* event, size_t size) const {
+		const char* end = event + size;
+		for (const auto& property : properties_) {
+			const char* ch = event;
+			while ((ch = property.finder.Find(ch, end)) != nullptr) {
+				const char* value = ch + property.finder.Size();
+				const char* value_end = LogEvent::PropertyValueEnd(value, end);
+				if (property.values.find(std::string_view(value, value_end - value)) != property.values.end()) {
+					return true;
+				}
+				ch = value;
+			}
+		}
+		return false;
+	}
+
+	bool TraceQuery::MayMatch(const FileSummary& summary) const {
+		for (const auto& property : properties_) {
+			if (!FileSummary::IsSummarized(property.name)) {
+				return true;
+			}
+			for (const auto& value : property.values) {
+				if (summary.MayContain(property.name, value)) {
+					return true;
+				}
+			}
+		}
+		return false;
+	}
+
+	std::string TraceQuery::Signature() const {
+		std::string signature;
+		for (const auto& property : properties_) {
+			std::vector<std::string_view> values(property.values.begin(), property.values.end());
+			std::sort(values.begin(), values.end());
+			signature.append(property.name).append("=");
+			for (size_t i = 0; i < values.size(); ++i) {
+				signature.append(i ? "," : "").append(values[i]);
+			}
+			signature.append(";");
+		}
+		return signature;
+	}
+
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <unordered_set>
+#include "simd_support.h"
+#include "substring_finder.h"
+#include "file_summary.h"
+
+namespace soldy {
+
+	//Отбор событий по значениям свойств (SessionID=, t:connectID=): событие подходит, если значение
+	//хотя бы одного свойства есть в заданном множестве. Свойство ищется SubstringFinder, значение - в хеш-множестве.
+	class TraceQuery {
+	public:
+		explicit TraceQuery(SimdSupport::SimdLevel simd_level);
+		void Add(const std::string& property, const std::string& value);
+		bool Empty() const noexcept { return properties_.empty(); }
+		bool Match(const char* event, size_t size) const;
+		//false - по сводке файла в нем нет ни одного из искомых значений, файл можно не читать
+		bool MayMatch(const FileSummary& summary) const;
+		//Запрос в каноническом виде (значения по порядку) для ключа кэша результатов
+		std::string Signature() const;
+	private:
+		struct StringHash {
+			using is_transparent = void;
+			size_t operator()(std::string_view value) const noexcept { return std::hash<std::string_view>()(value); }
+		};
+		struct Property {
+			std::string name;
+			SubstringFinder finder;
+			std::unordered_set<std::string, StringHash, std::equal_to<>> values;
+		};
+		SimdSupport::SimdLevel simd_level_;
+		std::vector<Property> properties_;
+	};
+
+}